@@ -20,30 +20,107 @@
  * how to get your <kernel version>:
  * like this,
  * $ uname -r
- * 4.2.0-36-generic
+ * 6.12.0-xx-generic
+ *
+ * baseline: Linux 6.12 (LTS); kernels before 6.7 are refused. pfn_t (vmf_insert_pfn_pmd())
+ * is gone from later mainline, so kernels past 6.12 may need a port.
  */
+#include <linux/capability.h>   /* capable()                 */
 #include <linux/cdev.h>         /* cdev_add()                */
+#include <linux/crc32c.h>       /* crc32c()                  */
 #include <linux/device.h>       /* device_create()           */
+#include <linux/dma-buf.h>      /* dma_buf_export()          */
+#include <linux/dma-mapping.h>  /* dma_map_sgtable()         */
 #include <linux/fs.h>           /* chrdev                    */
+#include <linux/huge_mm.h>      /* thp_get_unmapped_area()   */
 #include <linux/init.h>         /* macros: e.g., __init      */
+#include <linux/interval_tree_generic.h> /* INTERVAL_TREE_DEFINE() */
+#include <linux/io_uring/cmd.h> /* io_uring_sqe_cmd()        */
 #include <linux/kernel.h>       /* printk()                  */
-#include <linux/mm.h>           /* remap_pfn_range()         */
+#include <linux/kthread.h>      /* kthread_create()          */
+#include <linux/ktime.h>        /* ktime_get()               */
+#include <linux/lockdep.h>      /* lockdep_register_key()    */
+#include <linux/log2.h>         /* ilog2()                   */
+#include <linux/math64.h>       /* mul_u64_u64_div_u64()     */
+#include <linux/mm.h>           /* remap_vmalloc_range()     */
+#include <linux/pfn_t.h>        /* pfn_to_pfn_t()            */
+#include <linux/pipe_fs_i.h>    /* PIPE_DEF_BUFFERS          */
+#include <linux/scatterlist.h>  /* sg_alloc_table_from_pages() */
 #include <linux/module.h>       /* essential for all modules */
 #include <linux/mutex.h>        /* mutex()                   */
+#include <linux/percpu.h>       /* alloc_percpu()            */
+#include <linux/percpu-rwsem.h> /* percpu_down_read()        */
+#include <linux/pid_namespace.h> /* task_active_pid_ns()      */
+#include <linux/poll.h>         /* poll_wait()               */
 #include <linux/sched.h>        /* send_sig_info()           */
-#include <linux/slab.h>         /* kmalloc()/kfree()         */
+#include <linux/sched/mm.h>     /* mmgrab()                  */
+#include <linux/sizes.h>        /* SZ_1M                     */
+#include <linux/slab.h>         /* kzalloc()/kfree()         */
+#include <linux/spinlock.h>     /* spin_lock()               */
+#include <linux/splice.h>       /* splice_to_pipe()          */
 #include <linux/types.h>        /* u32, pid_t                */
-
+#include <linux/uaccess.h>      /* copy_(to|from)_user()     */
+#include <linux/uio.h>          /* iov_iter                  */
+#include <linux/version.h>      /* LINUX_VERSION_CODE        */
+#include <linux/vmalloc.h>      /* vmalloc_user()            */
+#include <linux/wait.h>         /* wait_event_interruptible()*/
+#include <linux/xxhash.h>       /* xxh64_update()            */
+
+#include <asm/cacheflush.h>     /* clflush_cache_range()     */
 #include <asm/io.h>
-#include <asm/uaccess.h>        /* copy_(to|from)_user()     */
 
 #include "zndkcdev.h"           /* own header  */
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 7, 0)
+#error "zndkcdev needs Linux 6.7 or later (baseline: 6.12)"
+#endif
+
 MODULE_LICENSE    ("Dual BSD/GPL");
 MODULE_DESCRIPTION("Linux simple character device driver for test");
 MODULE_AUTHOR     ("zundoko");
 MODULE_VERSION    (ZNDKCDEV_VERSION);
 
+/**
+ * @struct  TZndkCdevRing
+ * @brief   byte ring over a part of the device buffer (FIFO / shard)
+ */
+typedef struct {
+    char          *buf;              /* ring storage            */
+    size_t         len;              /* ring size [B]           */
+    size_t         head;             /* write index             */
+    size_t         tail;             /* read  index             */
+    size_t         n;                /* # of bytes queued       */
+} TZndkCdevRing;
+
+/**
+ * @struct  TZndkCdevShard
+ * @brief   per-CPU shard of the device buffer (SHARD mode)
+ */
+typedef struct {
+    struct mutex   mtx;              /* only contended when a writer migrates */
+    TZndkCdevRing  ring;             /* slice of the device buffer            */
+} ____cacheline_aligned_in_smp TZndkCdevShard;
+
+/**
+ * @struct  TZndkCdevRange
+ * @brief   byte-range lock over [start, last] of the device buffer
+ */
+typedef struct {
+    struct rb_node rb;               /* in dcb->rl_(rd|wr|wr_wait) */
+    loff_t         start;            /* first byte              */
+    loff_t         last;             /* last byte               */
+    loff_t         __subtree_last;   /* interval tree           */
+    struct list_head wait;           /* on dcb->rl_waiters while waiting */
+    struct task_struct *task;        /* the waiter              */
+    int            is_wr;            /* 0: shared, 1: exclusive */
+} TZndkCdevRange;
+
+#define  ZNDKCDEV_RL_START(rl)  ((rl)->start)
+#define  ZNDKCDEV_RL_LAST(rl)   ((rl)->last)
+
+INTERVAL_TREE_DEFINE(TZndkCdevRange, rb, loff_t, __subtree_last,
+                     ZNDKCDEV_RL_START, ZNDKCDEV_RL_LAST, static inline, _zndkcdev_rl)
+
 /**
  * @struct  TZndkCdevDCB
  * @brief   ZndkCdev Device Control Block (DCB)
@@ -52,18 +129,78 @@ typedef struct {
     int            minor;            /* minor # of cdev         */
 
     dev_t          dev_num;          /* device numver           */
-    struct cdev    c_dev;            /* character device        */
     struct device *dev;              /* device                  */
 
-    char          *buf;              /* test buffer (kmalloc)   */
+    char          *buf;              /* test buffer (vmalloc)   */
     int            len_buf;          /* test buffer size [B]    */
+    struct page  **hpages;           /* huge: PMD pages of buf  */
+    atomic_t       n_fault_pmd;      /* huge: PMD mappings made */
+    atomic_t       n_fault_pte;      /* huge: PTE fallbacks     */
+    atomic_t       n_open;           /* # of open files         */
+    atomic_t       n_mmap;           /* # of live mappings      */
+    TZndkCdevStats __percpu *stats;  /* per-CPU counters        */
 
     struct mutex   mtx;              /* resource blocking       */
+    struct percpu_rw_semaphore buf_sem; /* buf lifetime: R: data paths, W: resize */
+    struct lock_class_key buf_key;   /* lockdep class of buf_sem */
+    spinlock_t     rl_lock;          /* protects rl_*           */
+    struct rb_root_cached rl_rd;     /* held shared ranges      */
+    struct rb_root_cached rl_wr;     /* held exclusive ranges   */
+    struct rb_root_cached rl_wr_wait; /* queued exclusive ranges */
+    struct list_head rl_waiters;     /* queued ranges (any)     */
+
+    int            mode;             /* ZNDKCDEV_MODE_*         */
+    TZndkCdevRing  fifo;             /* FIFO: ring over buf     */
+    wait_queue_head_t wq_rd;         /* FIFO: wait for data     */
+    wait_queue_head_t wq_wr;         /* FIFO: wait for space    */
+
+    TZndkCdevShard *shard;           /* SHARD: [n_shard]        */
+    int            n_shard;          /* SHARD: # of shards      */
+    int            shard_next;       /* SHARD: next to drain    */
+
+    TZndkCdevFlipCtl *flip;          /* FLIP: control page      */
+
+    struct mutex   gen_mtx;          /* GEN: start/stop         */
+    struct task_struct *gen_task;    /* GEN: producer (NULL: stopped) */
+    TZndkCdevGen   gen;              /* GEN: parameters, counters */
+    u64            gen_seq;          /* GEN: next record #      */
+    unsigned long  gen_ofs;          /* GEN: FLAT: next record offset */
 
     int            init_done;        /* driver's been inited ?  */
 } TZndkCdevDCB;
-static  TZndkCdevDCB                 ZndkCdevDCB[N_ZNDKCDEV];
-#define _get_zndkcdev_dcb(minor)   (&ZndkCdevDCB[minor     ])
+
+/**
+ * @struct  TZndkCdevCmdq
+ * @brief   command queue of an open file (ZNDKCDEV_CMDQ_SETUP)
+ */
+typedef struct {
+    TZndkCdevDCB  *dcb;              /* device the commands run on         */
+    TZndkCdevCmdqHdr *hdr;           /* region shared w/ user (vmalloc_user) */
+    TZndkCdevSqe  *sqes;             /* = region + hdr->sq_ofs             */
+    TZndkCdevCqe  *cqes;             /* = region + hdr->cq_ofs             */
+    unsigned long  len;              /* region size [B]                    */
+    u32            sq_mask;          /* own copies: the region is writable by user */
+    u32            cq_mask;
+    u32            sq_head;          /* next SQE to consume                */
+    u32            cq_tail;          /* next CQE to post                   */
+    struct mutex   mtx;              /* w/o poller: one ENTER runs the SQ  */
+    struct mm_struct *mm;            /* submitter: BUF_RD/WR user buffers  */
+    struct pid_namespace *pid_ns;    /* submitter: NOTIFY pids             */
+    struct task_struct *poller;      /* SQ polling thread (NULL: none)     */
+    unsigned long  idle;             /* poller: idle time before sleeping [jiffies] */
+} TZndkCdevCmdq;
+
+/**
+ * @struct  TZndkCdevFile
+ * @brief   per-open state (filp->private_data)
+ */
+typedef struct {
+    TZndkCdevDCB  *dcb;              /* device opened           */
+    int            mmap_mode;        /* ZNDKCDEV_MMAP_*         */
+    TZndkCdevCmdq *cmdq;             /* command queue (NULL: none) */
+} TZndkCdevFile;
+#define _get_zndkcdev_file(filp)   ((TZndkCdevFile *)(filp)->private_data)
+#define _get_zndkcdev_filp_dcb(filp) (_get_zndkcdev_file(filp)->dcb)
 
 /**
  * @struct  TZndkCdevInfo
@@ -72,16 +209,35 @@ static  TZndkCdevDCB                 ZndkCdevDCB[N_ZNDKCDEV];
 typedef struct {
     char           ver[LEN_VER + 1]; /* versoin of this driver  */
 
-    TZndkCdevDCB  *dcb;              /* device control block    */
+    struct idr     idr;              /* minor # -> DCB          */
+    struct mutex   mtx;              /* idr, create/destroy     */
 
     struct class  *cl;               /* device class            */
     dev_t          dev_num;          /* device number           */
     int            major;            /* major # of cdev         */
-    int            n_dev;            /* # of devices to support */
+    int            n_dev;            /* # of live devices       */
+
+    struct cdev    c_dev;            /* one cdev for all minors */
+    struct device *dev_ctl;          /* /dev/zndkcdev_ctl       */
+    int            init_done;        /* c_dev has been added ?  */
 } TZndkCdevInfo;
 
 static TZndkCdevInfo              ZndkCdevInfo;
 #define _get_zndkcdev_info()    (&ZndkCdevInfo)
+#define _get_zndkcdev_dcb(minor)   ((TZndkCdevDCB *)idr_find(&_get_zndkcdev_info()->idr, (minor)))
+
+/* module parameters: insmod zndkcdev.ko n_dev=<n> len_buf=<B> */
+static int  zndkcdev_n_dev   = N_ZNDKCDEV;
+module_param_named(n_dev  , zndkcdev_n_dev  , int, 0444);
+MODULE_PARM_DESC  (n_dev  , "# of devices /dev/" NAME_MODULE "_<n> created at load (0.." __stringify(ZNDKCDEV_MAX_DEV) ")");
+
+static int  zndkcdev_len_buf = LEN_ZNDKCDEV_BUF;
+module_param_named(len_buf, zndkcdev_len_buf, int, 0444);
+MODULE_PARM_DESC  (len_buf, "initial buffer size of each device [B] (page aligned)");
+
+static int  zndkcdev_huge    = 0;
+module_param_named(huge   , zndkcdev_huge   , int, 0444);
+MODULE_PARM_DESC  (huge   , "back buffers w/ 2 MiB pages and map them w/ PMD entries (0: off, 1: on)");
 
 /**
  * _init_zndkcdev_info()
@@ -94,10 +250,20 @@ _init_zndkcdev_info(TZndkCdevInfo *info)
     memset(info, 0, sizeof(TZndkCdevInfo));
     snprintf(info->ver, LEN_VER, ZNDKCDEV_VERSION);
 
-    info->dcb      = _get_zndkcdev_dcb(0); /* 0: top of DCB */
+    if ((zndkcdev_n_dev < 0) || (zndkcdev_n_dev > ZNDKCDEV_MAX_DEV)) {
+        pr_err(" %s[--]: %s(): n_dev=%d is out of range\n", NAME_MODULE, __func__, zndkcdev_n_dev);
+        return  -EINVAL;
+    }
+    if ((zndkcdev_len_buf < PAGE_SIZE) || (zndkcdev_len_buf > ZNDKCDEV_MAX_BUF)) {
+        pr_err(" %s[--]: %s(): len_buf=%d is out of range\n", NAME_MODULE, __func__, zndkcdev_len_buf);
+        return  -EINVAL;
+    }
+
+    idr_init  (&info->idr);
+    mutex_init(&info->mtx);
 
     info->cl       =  NULL;
-    info->n_dev    =  N_ZNDKCDEV;
+    info->n_dev    =  0;        /* counted up by zndkcdev_probe() */
 
     return  stat;
 }
@@ -111,6 +277,9 @@ _cleanup_zndkcdev_info(TZndkCdevInfo *info)
 {
     int     stat   =  0;
 
+    idr_destroy  (&info->idr);
+    mutex_destroy(&info->mtx);
+
     memset(info, 0, sizeof(TZndkCdevInfo));
 
     return  stat;
@@ -129,9 +298,46 @@ _init_zndkcdev_dcb(TZndkCdevDCB *dcb)
     dcb->dev       =  NULL;
 
     dcb->buf       =  NULL;
-    dcb->len_buf   =  LEN_ZNDKCDEV_BUF;
+    dcb->len_buf   =  zndkcdev_len_buf;
+    dcb->hpages    =  NULL;
+    atomic_set(&dcb->n_fault_pmd, 0);
+    atomic_set(&dcb->n_fault_pte, 0);
+    atomic_set(&dcb->n_open, 0);
+    atomic_set(&dcb->n_mmap, 0);
+    dcb->stats     =  alloc_percpu(TZndkCdevStats);
+    if (dcb->stats == NULL) {
+        stat       = -ENOMEM;
+    }
 
     mutex_init(&dcb->mtx);
+    /* a class per dcb: COPY holds the buf_sems of two minors at once (in minor order) */
+    lockdep_register_key(&dcb->buf_key);
+    if (__percpu_init_rwsem(&dcb->buf_sem, "zndkcdev_dcb->buf_sem", &dcb->buf_key)) {
+        stat       = -ENOMEM;
+    }
+    spin_lock_init(&dcb->rl_lock);
+    dcb->rl_rd      = RB_ROOT_CACHED;
+    dcb->rl_wr      = RB_ROOT_CACHED;
+    dcb->rl_wr_wait = RB_ROOT_CACHED;
+    INIT_LIST_HEAD(&dcb->rl_waiters);
+
+    dcb->mode      =  ZNDKCDEV_MODE_FLAT;
+    memset(&dcb->fifo, 0, sizeof(TZndkCdevRing));
+    init_waitqueue_head(&dcb->wq_rd);
+    init_waitqueue_head(&dcb->wq_wr);
+
+    dcb->shard      =  NULL;
+    dcb->n_shard    =  0;
+    dcb->shard_next =  0;
+
+    dcb->flip      = (TZndkCdevFlipCtl *)get_zeroed_page(GFP_KERNEL);
+    if (dcb->flip  == NULL) {
+        stat       = -ENOMEM;
+    }
+
+    mutex_init(&dcb->gen_mtx);
+    dcb->gen_task  =  NULL;
+    memset(&dcb->gen, 0, sizeof(TZndkCdevGen));
 
     dcb->init_done = -1;
 
@@ -146,36 +352,226 @@ _cleanup_zndkcdev_dcb(TZndkCdevDCB *dcb)
 {
     int     stat   =  0;
 
+    free_percpu(dcb->stats);
+    free_page((unsigned long)dcb->flip);
+    mutex_destroy(&dcb->gen_mtx);
+    percpu_free_rwsem(&dcb->buf_sem);
+    lockdep_unregister_key(&dcb->buf_key);
     mutex_destroy(&dcb->mtx);
 
     return  stat;
 }
 
+/**
+ * _zndkcdev_buf_alloc_huge()
+ * @brief    allocate *len (rounded up to PMD_SIZE) as 2 MiB compound pages,
+ *           vmap()ed contiguously for the kernel side
+ */
+static char *
+_zndkcdev_buf_alloc_huge(unsigned long *len, struct page ***phpages)
+{
+    unsigned long  n_hp   = ALIGN(*len, PMD_SIZE) >> PMD_SHIFT;
+    unsigned long  n_pg   = n_hp << (PMD_SHIFT - PAGE_SHIFT);
+    struct page  **hpages;
+    struct page  **pages;
+    char          *buf    = NULL;
+    unsigned long  idx;
+    unsigned long  i;
+
+    hpages = kvcalloc(n_hp, sizeof(struct page *), GFP_KERNEL);
+    pages  = kvcalloc(n_pg, sizeof(struct page *), GFP_KERNEL);
+    if ((hpages == NULL) || (pages == NULL)) {
+        goto  huge_err;
+    }
+
+    for (idx = 0; idx < n_hp; idx++) {
+        hpages[idx] = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_COMP | __GFP_NOWARN,
+                                  PMD_SHIFT - PAGE_SHIFT);
+        if (hpages[idx] == NULL) {
+            goto  huge_err;
+        }
+        for (i = 0; i < (1UL << (PMD_SHIFT - PAGE_SHIFT)); i++) {
+            pages[(idx << (PMD_SHIFT - PAGE_SHIFT)) + i] = nth_page(hpages[idx], i);
+        }
+    }
+
+    buf = vmap(pages, n_pg, VM_MAP, PAGE_KERNEL);
+    if (buf == NULL) {
+        goto  huge_err;
+    }
+    kvfree(pages);
+
+    *len     = n_hp << PMD_SHIFT;
+    *phpages = hpages;
+
+    return  buf;
+
+huge_err:
+    for (idx = 0; (hpages != NULL) && (idx < n_hp); idx++) {
+        if (hpages[idx] != NULL) {
+            __free_pages(hpages[idx], PMD_SHIFT - PAGE_SHIFT);
+        }
+    }
+    kvfree(hpages);
+    kvfree(pages);
+
+    return  NULL;
+}
+
+/**
+ * _zndkcdev_buf_alloc()
+ * @brief    allocate a device buffer of *len [B]; *len is rounded up to the page
+ *           (or PMD) size actually allocated
+ *
+ *  huge=1 : 2 MiB pages (*phpages != NULL), falls back to 4 KiB if memory is fragmented
+ *  huge=0 : vmalloc_user(), zeroed and VM_USERMAP for remap_vmalloc_range()
+ */
+static char *
+_zndkcdev_buf_alloc(unsigned long *len, struct page ***phpages)
+{
+    char          *buf;
+
+    *phpages = NULL;
+
+    if (zndkcdev_huge) {
+        buf = _zndkcdev_buf_alloc_huge(len, phpages);
+        if (buf != NULL) {
+            return  buf;
+        }
+        pr_warn(" %s[--]: %s(): no 2 MiB pages for %lu B, fall back to 4 KiB pages\n",
+                NAME_MODULE, __func__, *len);
+    }
+
+    *len = PAGE_ALIGN(*len);
+
+    return  vmalloc_user(*len);
+}
+
+/**
+ * _zndkcdev_buf_free()
+ */
+static void
+_zndkcdev_buf_free(char *buf, unsigned long len, struct page **hpages)
+{
+    unsigned long  idx;
+
+    if (buf == NULL) {
+        return;
+    }
+
+    if (hpages == NULL) {
+        vfree(buf);
+        return;
+    }
+
+    vunmap(buf);
+    for (idx = 0; idx < (len >> PMD_SHIFT); idx++) {
+        __free_pages(hpages[idx], PMD_SHIFT - PAGE_SHIFT);
+    }
+    kvfree(hpages);
+}
+
+/**
+ * _zndkcdev_stat()
+ * @brief    account one operation to this CPU's counters
+ * @rslt     < 0: error
+ * @n_byte   bytes moved
+ * @t0       ktime_get() at entry
+ */
+static void
+_zndkcdev_stat(TZndkCdevDCB *dcb, int op, long rslt, size_t n_byte, ktime_t t0)
+{
+    u64              ns   = ktime_to_ns(ktime_sub(ktime_get(), t0));
+    int              bkt  = (ns > 1) ? ilog2(ns) : 0; /* [2^bkt, 2^(bkt+1)) ns */
+    TZndkCdevStatOp *st;
+
+    st = &get_cpu_ptr(dcb->stats)->op[op];
+    if (rslt < 0) {
+        st->n_err++;
+    } else {
+        st->n_op++;
+        st->n_byte += n_byte;
+    }
+    st->hist[min(bkt, ZNDKCDEV_N_HIST - 1)]++;
+    put_cpu_ptr(dcb->stats);
+}
+
+/**
+ * zndkcdev_get_stats()
+ * @brief    sum the per-CPU counters (a snapshot, not atomic across CPUs)
+ */
+static void
+zndkcdev_get_stats(TZndkCdevDCB *dcb, TZndkCdevStats *stats)
+{
+    TZndkCdevStats *pcs;
+    int             cpu;
+    int             op;
+    int             bkt;
+
+    memset(stats, 0, sizeof(TZndkCdevStats));
+    for_each_possible_cpu(cpu) {
+        pcs = per_cpu_ptr(dcb->stats, cpu);
+        for (op = 0; op < ZNDKCDEV_N_STAT; op++) {
+            stats->op[op].n_op   += pcs->op[op].n_op;
+            stats->op[op].n_byte += pcs->op[op].n_byte;
+            stats->op[op].n_err  += pcs->op[op].n_err;
+            for (bkt = 0; bkt < ZNDKCDEV_N_HIST; bkt++) {
+                stats->op[op].hist[bkt] += pcs->op[op].hist[bkt];
+            }
+        }
+    }
+}
+
 /**
  * zndkcdev_send_signal()
+ * @ns       pid namespace sigmsg->pid is numbered in: the submitter's
  */
 static int
-zndkcdev_send_signal(TZndkCdevDCB *dcb, TSigMsg *sigmsg)
+zndkcdev_send_signal(TZndkCdevDCB *dcb, TSigMsg *sigmsg, struct pid_namespace *ns)
 {
-    int                 stat   = 0;
+    int                 stat;
     int                 signum;
-    struct siginfo      sinfo;
+    struct kernel_siginfo sinfo;
     struct task_struct *task;
 
-    task = get_pid_task(find_get_pid(sigmsg->pid), PIDTYPE_PID);
+    rcu_read_lock();
+    task = get_pid_task(find_pid_ns(sigmsg->pid, ns), PIDTYPE_PID);
+    rcu_read_unlock();
+    if (task == NULL) {
+        return  -ESRCH;
+    }
 
-    memset(&sinfo, 0, sizeof(struct siginfo));
+    clear_siginfo(&sinfo);
     signum         = SIGUSR1;
     sinfo.si_signo = signum;
     sinfo.si_code  = SI_QUEUE;
     sinfo.si_int   = sigmsg->dat;
 
-    pr_info(" %s(): send SIGNAL: signum=%d, si_int=%d\n", __func__, signum, sigmsg->dat);
-    send_sig_info(signum, &sinfo, task);
+    stat = send_sig_info(signum, &sinfo, task);
+    put_task_struct(task);
 
     return  stat;
 }
 
+/**
+ * _zndkcdev_cmdq_free()
+ * @brief    stop the poller and free the queue (the file is going away: nothing maps it)
+ */
+static void
+_zndkcdev_cmdq_free(TZndkCdevCmdq *cmdq)
+{
+    if (cmdq->poller != NULL) {
+        kthread_stop(cmdq->poller);
+    }
+    mmdrop(cmdq->mm);
+    put_pid_ns(cmdq->pid_ns);
+    vfree(cmdq->hdr);
+    mutex_destroy(&cmdq->mtx);
+    kfree(cmdq);
+}
+
+static const struct file_operations zndkcdev_ctl_fops;
+
 /**
  * zndkcdev_open()
  */
@@ -184,13 +580,42 @@ zndkcdev_open(struct inode *i, struct file *filp)
 {
     TZndkCdevInfo  *info  = _get_zndkcdev_info();
     int             minor =  MINOR(i->i_rdev);
-    TZndkCdevDCB   *dcb   = _get_zndkcdev_dcb(minor);
+    TZndkCdevDCB   *dcb;
+    TZndkCdevFile  *zf;
 
     pr_info(" %s[%2d]: %s(): major=%d, minor=%d\n",
             NAME_MODULE, minor, __func__, info->major, minor);
 
-    /* save DCB as private data */
-    filp->private_data = dcb;
+    if (minor == ZNDKCDEV_CTL_MINOR) {
+        replace_fops(filp, fops_get(&zndkcdev_ctl_fops));
+        return  0;
+    }
+
+    zf = kzalloc(sizeof(TZndkCdevFile), GFP_KERNEL);
+    if (zf == NULL) {
+        return  -ENOMEM;
+    }
+
+    /* look the device up and pin it against ZNDKCDEV_CTL_DESTROY */
+    mutex_lock(&info->mtx);
+    dcb = _get_zndkcdev_dcb(minor);
+    if (dcb != NULL) {
+        atomic_inc(&dcb->n_open);
+    }
+    mutex_unlock(&info->mtx);
+    if (dcb == NULL) {
+        kfree(zf);
+        return  -ENODEV;
+    }
+
+    zf->dcb            = dcb;
+    zf->mmap_mode      = ZNDKCDEV_MMAP_WB;
+
+    /* save per-open state as private data */
+    filp->private_data = zf;
+
+    /* read_iter/write_iter honor IOCB_NOWAIT: let io_uring try inline first */
+    filp->f_mode      |= FMODE_NOWAIT;
 
     return  0;
 }
@@ -201,189 +626,2311 @@ zndkcdev_open(struct inode *i, struct file *filp)
 static int
 zndkcdev_close(struct inode *i, struct file *filp)
 {
-    TZndkCdevDCB  *dcb = (TZndkCdevDCB *)filp->private_data;
+    TZndkCdevDCB  *dcb = _get_zndkcdev_filp_dcb(filp);
+    TZndkCdevFile *zf  = _get_zndkcdev_file(filp);
 
     pr_info(" %s[%2d]: %s()\n", NAME_MODULE, dcb->minor, __func__);
 
+    if (zf->cmdq != NULL) {
+        _zndkcdev_cmdq_free(zf->cmdq); /* before n_open lets the device go */
+    }
+    atomic_dec(&dcb->n_open);
+    kfree(filp->private_data);
+    filp->private_data = NULL;
+
     return  0;
 }
 
 /**
- * zndkcdev_read()
+ * _zndkcdev_nowait()
+ * @brief    the caller must not sleep: O_NONBLOCK or IOCB_NOWAIT (io_uring)
  */
-static ssize_t
-zndkcdev_read(struct file *filp,       char __user *ubuf, size_t count, loff_t *fpos)
+static inline int
+_zndkcdev_nowait(struct kiocb *iocb)
 {
-    int            stat  = 0;
-    TZndkCdevDCB  *dcb   = (TZndkCdevDCB *)filp->private_data;
+    return  (iocb->ki_filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
+}
+
+/**
+ * _zndkcdev_fifo_lock()
+ * @brief    take dcb->mtx, never sleeping on it for a nowait caller
+ */
+static inline int
+_zndkcdev_fifo_lock(TZndkCdevDCB *dcb, int nowait)
+{
+    if (nowait) {
+        return  mutex_trylock(&dcb->mtx) ? 0 : -EAGAIN;
+    }
+    if (mutex_lock_interruptible(&dcb->mtx)) {
+        return  -ERESTARTSYS;
+    }
+
+    return  0;
+}
+
+/**
+ * _zndkcdev_ring_init()
+ */
+static inline void
+_zndkcdev_ring_init(TZndkCdevRing *ring, char *buf, size_t len)
+{
+    ring->buf   = buf;
+    ring->len   = len;
+    ring->head  = 0;
+    ring->tail  = 0;
+    ring->n     = 0;
+}
+
+/**
+ * _zndkcdev_ring_get()
+ * @brief    move up to count queued bytes into the iovecs (caller holds the ring's lock)
+ * @return   # of bytes moved (short on fault)
+ */
+static size_t
+_zndkcdev_ring_get(TZndkCdevRing *ring, struct iov_iter *to, size_t count)
+{
+    size_t         done  = 0;
     size_t         len;
+    size_t         chunk;
     size_t         remain;
-    void          *buf;
 
-    pr_info(" %s[%2d]: %s()\n", NAME_MODULE, dcb->minor, __func__);
+    len         = (count < ring->n) ? count : ring->n;
+    while (len  > 0) {          /* at most 2 chunks: tail -> end, top -> head */
+        chunk   =  ring->len - ring->tail;
+        chunk   = (len < chunk) ? len : chunk;
 
-//    if (mutex_lock_interruptible(&dcb->mtx)) {
-//        return  -ERESTARTSYS;
-//    }
+        remain  =  chunk - copy_to_iter(ring->buf + ring->tail, chunk, to);
+        chunk  -=  remain;
 
-    if (*fpos  >= dcb->len_buf) {
-        stat    = 0;
-        goto  read_unlock;
+        ring->tail  = (ring->tail + chunk) % ring->len;
+        ring->n    -=  chunk;
+        done       +=  chunk;
+        len        -=  chunk;
+        if (remain != 0) {
+            break;
+        }
+    }
+
+    return  done;
+}
+
+/**
+ * _zndkcdev_ring_put()
+ * @brief    append up to count bytes from the iovecs (caller holds the ring's lock)
+ * @return   # of bytes appended (short when full or on fault)
+ */
+static size_t
+_zndkcdev_ring_put(TZndkCdevRing *ring, struct iov_iter *from, size_t count)
+{
+    size_t         done  = 0;
+    size_t         len;
+    size_t         chunk;
+    size_t         remain;
+
+    len         =  ring->len - ring->n;
+    len         = (count < len) ? count : len;
+    while (len  > 0) {          /* at most 2 chunks: head -> end, top -> tail */
+        chunk   =  ring->len - ring->head;
+        chunk   = (len < chunk) ? len : chunk;
+
+        remain  =  chunk - copy_from_iter(ring->buf + ring->head, chunk, from);
+        chunk  -=  remain;
+
+        ring->head  = (ring->head + chunk) % ring->len;
+        ring->n    +=  chunk;
+        done       +=  chunk;
+        len        -=  chunk;
+        if (remain != 0) {
+            break;
+        }
+    }
+
+    return  done;
+}
+
+/**
+ * zndkcdev_fifo_read()
+ * @brief    consume data from the ring buffer, block while it is empty
+ */
+static ssize_t
+zndkcdev_fifo_read(TZndkCdevDCB *dcb, struct kiocb *iocb, struct iov_iter *to)
+{
+    ssize_t        stat  = 0;
+    size_t         count = iov_iter_count(to);
+    int            nowait = _zndkcdev_nowait(iocb);
+
+    if (count == 0) {
+        return  0;
+    }
+
+    stat = _zndkcdev_fifo_lock(dcb, nowait);
+    if (stat < 0) {
+        return  stat;
+    }
+
+    while (dcb->fifo.n == 0) {  /* empty */
+        mutex_unlock(&dcb->mtx);
+        if (nowait) {
+            return  -EAGAIN;
+        }
+        if (wait_event_interruptible(dcb->wq_rd, READ_ONCE(dcb->fifo.n) != 0)) {
+            return  -ERESTARTSYS;
+        }
+        if (mutex_lock_interruptible(&dcb->mtx)) {
+            return  -ERESTARTSYS;
+        }
+    }
+
+    stat = _zndkcdev_ring_get(&dcb->fifo, to, count);
+    if (stat == 0) {
+        stat    = -EFAULT;
+    }
+
+    mutex_unlock(&dcb->mtx);
+
+    if (stat > 0) {
+        wake_up_interruptible(&dcb->wq_wr);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_fifo_write()
+ * @brief    append data to the ring buffer, block while it is full
+ */
+static ssize_t
+zndkcdev_fifo_write(TZndkCdevDCB *dcb, struct kiocb *iocb, struct iov_iter *from)
+{
+    ssize_t        stat  = 0;
+    size_t         count = iov_iter_count(from);
+    int            nowait = _zndkcdev_nowait(iocb);
+
+    if (count == 0) {
+        return  0;
+    }
+
+    stat = _zndkcdev_fifo_lock(dcb, nowait);
+    if (stat < 0) {
+        return  stat;
+    }
+
+    while (dcb->fifo.n == dcb->fifo.len) { /* full */
+        mutex_unlock(&dcb->mtx);
+        if (nowait) {
+            return  -EAGAIN;
+        }
+        if (wait_event_interruptible(dcb->wq_wr, READ_ONCE(dcb->fifo.n) != dcb->fifo.len)) {
+            return  -ERESTARTSYS;
+        }
+        if (mutex_lock_interruptible(&dcb->mtx)) {
+            return  -ERESTARTSYS;
+        }
+    }
+
+    stat = _zndkcdev_ring_put(&dcb->fifo, from, count);
+    if (stat == 0) {
+        stat    = -EFAULT;
+    }
+
+    mutex_unlock(&dcb->mtx);
+
+    if (stat > 0) {
+        wake_up_interruptible(&dcb->wq_rd);
+    }
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_shard_queued()
+ * @brief    # of bytes queued over all shards (lockless snapshot)
+ */
+static size_t
+_zndkcdev_shard_queued(TZndkCdevDCB *dcb)
+{
+    size_t         n     = 0;
+    int            idx;
+
+    for (idx = 0; idx < dcb->n_shard; idx++) {
+        n += READ_ONCE(dcb->shard[idx].ring.n);
+    }
+
+    return  n;
+}
+
+/**
+ * _zndkcdev_shard_cur()
+ * @brief    shard a write from the current CPU goes to
+ */
+static TZndkCdevShard *
+_zndkcdev_shard_cur(TZndkCdevDCB *dcb)
+{
+    return  &dcb->shard[raw_smp_processor_id() % dcb->n_shard];
+}
+
+/**
+ * zndkcdev_shard_write()
+ * @brief    append data to the shard of the current CPU: writers on different
+ *           CPUs never share a lock or a cache line
+ */
+static ssize_t
+zndkcdev_shard_write(TZndkCdevDCB *dcb, struct kiocb *iocb, struct iov_iter *from)
+{
+    ssize_t         stat  = 0;
+    size_t          count = iov_iter_count(from);
+    int             nowait = _zndkcdev_nowait(iocb);
+    TZndkCdevShard *shard;
+
+    if (count == 0) {
+        return  0;
+    }
+
+    /* a migration after this point only costs contention, not correctness */
+    shard = _zndkcdev_shard_cur(dcb);
+
+    if (nowait) {
+        if (!mutex_trylock(&shard->mtx)) {
+            return  -EAGAIN;
+        }
+    } else if (mutex_lock_interruptible(&shard->mtx)) {
+        return  -ERESTARTSYS;
+    }
+
+    while (shard->ring.n == shard->ring.len) { /* full */
+        mutex_unlock(&shard->mtx);
+        if (nowait) {
+            return  -EAGAIN;
+        }
+        if (wait_event_interruptible(dcb->wq_wr, READ_ONCE(shard->ring.n) != shard->ring.len)) {
+            return  -ERESTARTSYS;
+        }
+        if (mutex_lock_interruptible(&shard->mtx)) {
+            return  -ERESTARTSYS;
+        }
+    }
+
+    stat = _zndkcdev_ring_put(&shard->ring, from, count);
+    if (stat == 0) {
+        stat    = -EFAULT;
+    }
+
+    mutex_unlock(&shard->mtx);
+
+    if ((stat > 0) && wq_has_sleeper(&dcb->wq_rd)) {
+        wake_up_interruptible(&dcb->wq_rd);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_shard_drain()
+ * @brief    drain one shard (idx >= 0) or merge all shards round-robin (idx < 0)
+ *           into the iovecs, block while everything is empty
+ */
+static ssize_t
+zndkcdev_shard_drain(TZndkCdevDCB *dcb, struct iov_iter *to, int idx, int nowait)
+{
+    ssize_t         stat  = 0;
+    size_t          count = iov_iter_count(to);
+    TZndkCdevShard *shard;
+    size_t          done;
+    int             first;
+    int             n;
+    int             i;
+
+    if ((idx >= dcb->n_shard) || (count == 0)) {
+        return  (count == 0) ? 0 : -EINVAL;
+    }
+
+    while ((idx < 0) ? (_zndkcdev_shard_queued(dcb) == 0) : (READ_ONCE(dcb->shard[idx].ring.n) == 0)) {
+        if (nowait) {
+            return  -EAGAIN;
+        }
+        if (wait_event_interruptible(dcb->wq_rd,
+                                     (idx < 0) ? (_zndkcdev_shard_queued(dcb) != 0)
+                                               : (READ_ONCE(dcb->shard[idx].ring.n) != 0))) {
+            return  -ERESTARTSYS;
+        }
+    }
+
+    first = (idx < 0) ? READ_ONCE(dcb->shard_next) : idx;
+    n     = (idx < 0) ? dcb->n_shard : 1;
+    for (i = 0; (i < n) && (stat < count); i++) {
+        shard = &dcb->shard[(first + i) % dcb->n_shard];
+        if (READ_ONCE(shard->ring.n) == 0) {
+            continue;
+        }
+        if (mutex_lock_interruptible(&shard->mtx)) {
+            break;
+        }
+        done  = _zndkcdev_ring_get(&shard->ring, to, count - stat);
+        mutex_unlock(&shard->mtx);
+        if (done == 0) {
+            break;              /* fault */
+        }
+        stat += done;
+    }
+    if (idx < 0) {
+        WRITE_ONCE(dcb->shard_next, (first + 1) % dcb->n_shard); /* fairness */
+    }
+    if (stat == 0) {
+        stat    = -EFAULT;
+    }
+
+    if (stat > 0) {
+        wake_up_interruptible(&dcb->wq_wr);
+    }
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_shard_reset()
+ * @brief    (re-)slice the device buffer into n_shard rings (caller holds dcb->mtx)
+ */
+static void
+_zndkcdev_shard_reset(TZndkCdevDCB *dcb)
+{
+    size_t          len   = rounddown(dcb->len_buf / dcb->n_shard, L1_CACHE_BYTES);
+    int             idx;
+
+    for (idx = 0; idx < dcb->n_shard; idx++) {
+        mutex_lock(&dcb->shard[idx].mtx);
+        _zndkcdev_ring_init(&dcb->shard[idx].ring, dcb->buf + idx * len, len);
+        mutex_unlock(&dcb->shard[idx].mtx);
+    }
+    dcb->shard_next = 0;
+}
+
+/**
+ * _zndkcdev_range_busy()
+ * @brief    does rl conflict w/ a held range, or (reader) w/ a queued writer?
+ *           readers share; queued writers keep new overlapping readers out so a
+ *           steady reader stream can't starve them (caller holds dcb->rl_lock)
+ */
+static bool
+_zndkcdev_range_busy(TZndkCdevDCB *dcb, TZndkCdevRange *rl)
+{
+    if (_zndkcdev_rl_iter_first(&dcb->rl_wr, rl->start, rl->last) != NULL) {
+        return  true;
+    }
+    if (rl->is_wr) {
+        return  _zndkcdev_rl_iter_first(&dcb->rl_rd     , rl->start, rl->last) != NULL;
+    }
+    return  _zndkcdev_rl_iter_first(&dcb->rl_wr_wait, rl->start, rl->last) != NULL;
+}
+
+/**
+ * _zndkcdev_range_wake()
+ * @brief    wake the queued readers (wake_rd) and/or writers (wake_wr) overlapping
+ *           rl, the only ones rl going away can let in (caller holds dcb->rl_lock)
+ */
+static void
+_zndkcdev_range_wake(TZndkCdevDCB *dcb, TZndkCdevRange *rl, int wake_rd, int wake_wr)
+{
+    TZndkCdevRange *cur;
+
+    list_for_each_entry(cur, &dcb->rl_waiters, wait) {
+        if ((cur->is_wr ? wake_wr : wake_rd) && (cur->start <= rl->last) && (rl->start <= cur->last)) {
+            wake_up_process(cur->task);
+        }
+    }
+}
+
+/**
+ * _zndkcdev_range_lock()
+ * @brief    lock [ofs, ofs + len) of dcb->buf, shared (is_wr = 0) or exclusive
+ *           (is_wr = 1); caller holds dcb->buf_sem for read
+ */
+static int
+_zndkcdev_range_lock(TZndkCdevDCB *dcb, TZndkCdevRange *rl, loff_t ofs, size_t len, int is_wr)
+{
+    int            stat = 0;
+
+    rl->start   = ofs;
+    rl->last    = ofs + len - 1;
+    rl->is_wr   = is_wr;
+
+    spin_lock(&dcb->rl_lock);
+    if (!_zndkcdev_range_busy(dcb, rl)) {
+        _zndkcdev_rl_insert(rl, is_wr ? &dcb->rl_wr : &dcb->rl_rd);
+        spin_unlock(&dcb->rl_lock);
+        return  0;
+    }
+
+    rl->task    = current;
+    list_add_tail(&rl->wait, &dcb->rl_waiters);
+    if (is_wr) {
+        _zndkcdev_rl_insert(rl, &dcb->rl_wr_wait); /* new overlapping readers queue behind */
+    }
+    for (;;) {
+        set_current_state(TASK_INTERRUPTIBLE); /* before unlock: a wakeup can't get lost */
+        spin_unlock(&dcb->rl_lock);
+        schedule();
+        spin_lock(&dcb->rl_lock);
+        if (!_zndkcdev_range_busy(dcb, rl)) {
+            break;
+        }
+        if (signal_pending(current)) {
+            stat = -ERESTARTSYS;
+            break;
+        }
+    }
+    __set_current_state(TASK_RUNNING);
+    list_del(&rl->wait);
+    if (is_wr) {
+        _zndkcdev_rl_remove(rl, &dcb->rl_wr_wait);
+    }
+    if (stat == 0) {
+        _zndkcdev_rl_insert(rl, is_wr ? &dcb->rl_wr : &dcb->rl_rd);
+    } else if (is_wr) {
+        _zndkcdev_range_wake(dcb, rl, 1, 0); /* readers we held back */
+    }
+    spin_unlock(&dcb->rl_lock);
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_range_unlock()
+ * @brief    a released reader can only let writers in, a writer anybody
+ */
+static void
+_zndkcdev_range_unlock(TZndkCdevDCB *dcb, TZndkCdevRange *rl)
+{
+    spin_lock(&dcb->rl_lock);
+    _zndkcdev_rl_remove(rl, rl->is_wr ? &dcb->rl_wr : &dcb->rl_rd);
+    if (!list_empty(&dcb->rl_waiters)) {
+        _zndkcdev_range_wake(dcb, rl, rl->is_wr, 1);
+    }
+    spin_unlock(&dcb->rl_lock);
+}
+
+/**
+ * _zndkcdev_frame_len()
+ * @brief    FLIP: size of one frame, half of the buffer (page aligned)
+ */
+static inline unsigned long
+_zndkcdev_frame_len(TZndkCdevDCB *dcb)
+{
+    return  (dcb->len_buf / 2) & PAGE_MASK;
+}
+
+/**
+ * _zndkcdev_flat_len()
+ * @brief    bytes addressable by read/write/BUF_RD/BUF_WR: the buffer, or a frame in FLIP mode
+ */
+static inline unsigned long
+_zndkcdev_flat_len(TZndkCdevDCB *dcb)
+{
+    return  (dcb->mode == ZNDKCDEV_MODE_FLIP) ? _zndkcdev_frame_len(dcb) : dcb->len_buf;
+}
+
+/**
+ * _zndkcdev_flat_lock()
+ * @brief    range lock [ofs, ofs + len) for a flat R/W; in FLIP mode ofs is relative
+ *           to the front (shared) or back (exclusive) frame of the generation the
+ *           lock was taken in; caller holds dcb->buf_sem for read
+ * @return   offset of the frame in dcb->buf (0 out of FLIP mode), or -ERESTARTSYS
+ */
+static long
+_zndkcdev_flat_lock(TZndkCdevDCB *dcb, TZndkCdevRange *rl, loff_t ofs, size_t len, int is_wr)
+{
+    u64            gen;
+    unsigned long  base;
+
+    if (dcb->mode != ZNDKCDEV_MODE_FLIP) {
+        return  _zndkcdev_range_lock(dcb, rl, ofs, len, is_wr);
+    }
+
+    for (;;) {
+        gen  = smp_load_acquire(&dcb->flip->gen);
+        base = ((gen & 1) ^ is_wr) * _zndkcdev_frame_len(dcb);
+        if (_zndkcdev_range_lock(dcb, rl, base + ofs, len, is_wr) < 0) {
+            return  -ERESTARTSYS;
+        }
+        if (READ_ONCE(dcb->flip->gen) == gen) {
+            return  base;       /* a flip now waits for us (writer) or can't touch our frame (reader) */
+        }
+        _zndkcdev_range_unlock(dcb, rl); /* flipped meanwhile: the frame changed roles */
+    }
+}
+
+/**
+ * _zndkcdev_flip_ctl_update()
+ * @brief    refresh the frame geometry in the control page (mode set, buffer resized)
+ */
+static void
+_zndkcdev_flip_ctl_update(TZndkCdevDCB *dcb)
+{
+    dcb->flip->len_frame = _zndkcdev_frame_len(dcb);
+    dcb->flip->ofs_front = (dcb->flip->gen & 1) * dcb->flip->len_frame;
+}
+
+/**
+ * zndkcdev_flip()
+ * @brief    FLIP mode: publish the back frame as the new front
+ * @dcb
+ * @gen      out: generation now visible
+ * @note     the whole back frame is locked exclusively: in-flight writes to it
+ *           complete first, readers of the old front keep it until they finish
+ */
+static int
+zndkcdev_flip(TZndkCdevDCB *dcb, u64 *gen)
+{
+    TZndkCdevRange rl;
+    long           base;
+    int            stat = 0;
+
+    percpu_down_read(&dcb->buf_sem);
+    if ((dcb->mode != ZNDKCDEV_MODE_FLIP) || (_zndkcdev_frame_len(dcb) == 0)) {
+        stat = -EINVAL;
+        goto  flip_unlock;
+    }
+
+    base = _zndkcdev_flat_lock(dcb, &rl, 0, _zndkcdev_frame_len(dcb), 1);
+    if (base < 0) {
+        stat = base;
+        goto  flip_unlock;
+    }
+    *gen                 = dcb->flip->gen + 1;
+    dcb->flip->ofs_front = base;
+    smp_store_release(&dcb->flip->gen, *gen);
+    _zndkcdev_range_unlock(dcb, &rl);
+
+flip_unlock:
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_set_mode()
+ * @dcb
+ * @mode
+ */
+static int
+zndkcdev_set_mode(TZndkCdevDCB *dcb, int mode)
+{
+    if ((mode != ZNDKCDEV_MODE_FLAT) && (mode != ZNDKCDEV_MODE_FIFO) &&
+        (mode != ZNDKCDEV_MODE_SHARD) && (mode != ZNDKCDEV_MODE_FLIP)) {
+        pr_err(" %s[%2d]: %s(): unknown mode %d\n", NAME_MODULE, dcb->minor, __func__, mode);
+        return  -EINVAL;
+    }
+
+    if (mutex_lock_interruptible(&dcb->mtx)) {
+        return  -ERESTARTSYS;
+    }
+    percpu_down_write(&dcb->buf_sem); /* flat R/W see one mode from lock to unlock */
+    dcb->mode      =  mode;     /* switching mode drops queued data */
+    _zndkcdev_flip_ctl_update(dcb);
+    percpu_up_write(&dcb->buf_sem);
+    _zndkcdev_ring_init(&dcb->fifo, dcb->buf, dcb->len_buf);
+    _zndkcdev_shard_reset(dcb);
+    mutex_unlock(&dcb->mtx);
+
+    /* let blocked readers/writers re-check the new state */
+    wake_up_interruptible(&dcb->wq_rd);
+    wake_up_interruptible(&dcb->wq_wr);
+
+    return  0;
+}
+
+/**
+ * _zndkcdev_gen_put()
+ * @brief    write one record at ofs of a ring of len_ring [B] (wraps at its end)
+ */
+static void
+_zndkcdev_gen_put(char *ring, size_t len_ring, size_t ofs, const TZndkCdevRec *rec)
+{
+    size_t         len_pay = rec->len - sizeof(TZndkCdevRec);
+    size_t         n;
+
+    n   = min_t(size_t, sizeof(TZndkCdevRec), len_ring - ofs);
+    memcpy(ring + ofs, rec, n);
+    memcpy(ring, (const char *)rec + n, sizeof(TZndkCdevRec) - n);
+    ofs = (ofs + sizeof(TZndkCdevRec)) % len_ring;
+
+    n   = min_t(size_t, len_pay, len_ring - ofs);
+    memset(ring + ofs, (u8)rec->seq, n);
+    memset(ring, (u8)rec->seq, len_pay - n);
+}
+
+/**
+ * _zndkcdev_gen_flat()
+ * @brief    FLAT: up to n records at gen_ofs, wrapping around to 0 (one lap at most);
+ *           FLIP: up to a frame of records into the back frame, then flip
+ * @return   # of records written
+ */
+static u64
+_zndkcdev_gen_flat(TZndkCdevDCB *dcb, u64 n)
+{
+    TZndkCdevRange rl;
+    TZndkCdevRec   rec     = { 0, 0, dcb->gen.len_rec, ZNDKCDEV_REC_MAGIC };
+    unsigned long  len_rec = dcb->gen.len_rec;
+    unsigned long  region;
+    unsigned long  ofs;
+    long           base;
+    u64            done    = 0;
+    u64            k;
+    u64            gen;
+    int            is_flip;
+
+    percpu_down_read(&dcb->buf_sem);
+    if ((dcb->mode == ZNDKCDEV_MODE_FIFO) || (dcb->mode == ZNDKCDEV_MODE_SHARD)) {
+        percpu_up_read(&dcb->buf_sem); /* mode changed since the producer looked */
+        return  0;
+    }
+    is_flip = (dcb->mode == ZNDKCDEV_MODE_FLIP);
+    region  = _zndkcdev_flat_len(dcb);
+    n       = min_t(u64, n, region / len_rec);
+    ofs     = is_flip ? 0 : dcb->gen_ofs;
+    while (done < n) {
+        if (ofs + len_rec > region) {
+            ofs = 0;
+        }
+        k    = min_t(u64, n - done, (region - ofs) / len_rec);
+        base = _zndkcdev_flat_lock(dcb, &rl, ofs, k * len_rec, 1);
+        if (base < 0) {
+            break;
+        }
+        rec.t_ns = ktime_get_ns(); /* once per batch: cheap enough for tiny records */
+        for (; k > 0; k--, done++, ofs += len_rec) {
+            rec.seq = dcb->gen_seq++;
+            _zndkcdev_gen_put(dcb->buf + base, region, ofs, &rec);
+        }
+        _zndkcdev_range_unlock(dcb, &rl);
+    }
+    if (!is_flip) {
+        dcb->gen_ofs = ofs;
+    }
+    percpu_up_read(&dcb->buf_sem);
+
+    if (is_flip && (done > 0)) {
+        zndkcdev_flip(dcb, &gen);
+    }
+
+    return  done;
+}
+
+/**
+ * _zndkcdev_gen_fifo()
+ * @brief    FIFO: queue up to n whole records, never blocking (what doesn't fit is dropped)
+ * @return   # of records written
+ */
+static u64
+_zndkcdev_gen_fifo(TZndkCdevDCB *dcb, u64 n)
+{
+    TZndkCdevRing *ring    = &dcb->fifo;
+    TZndkCdevRec   rec     = { 0, 0, dcb->gen.len_rec, ZNDKCDEV_REC_MAGIC };
+    unsigned long  len_rec = dcb->gen.len_rec;
+    u64            done;
+
+    mutex_lock(&dcb->mtx);
+    if (dcb->mode != ZNDKCDEV_MODE_FIFO) {
+        mutex_unlock(&dcb->mtx);
+        return  0;
+    }
+    n        = min_t(u64, n, (ring->len - ring->n) / len_rec);
+    rec.t_ns = ktime_get_ns();
+    for (done = 0; done < n; done++) {
+        rec.seq     = dcb->gen_seq++;
+        _zndkcdev_gen_put(ring->buf, ring->len, ring->head, &rec);
+        ring->head  = (ring->head + len_rec) % ring->len;
+        ring->n    +=  len_rec;
+    }
+    mutex_unlock(&dcb->mtx);
+
+    if (done > 0) {
+        wake_up_interruptible(&dcb->wq_rd);
+    }
+
+    return  done;
+}
+
+/**
+ * zndkcdev_gen_thread()
+ * @brief    synthetic producer: every period_us (hrtimer sleep) write the records
+ *           due at rate since the start, so timer slack and late wakeups don't
+ *           skew the average rate; records that can't be written count as drops
+ */
+static int
+zndkcdev_gen_thread(void *arg)
+{
+    TZndkCdevDCB  *dcb    = (TZndkCdevDCB *)arg;
+    TZndkCdevGen  *gen    = &dcb->gen;
+    u64            period = (u64)gen->period_us * NSEC_PER_USEC;
+    ktime_t        t0     = ktime_get();
+    ktime_t        t_next = t0;
+    u64            n_due  = 0;      /* # of records due so far        */
+    u64            due;
+    u64            done;
+
+    while (!kthread_should_stop()) {
+        if (gen->rate != 0) {
+            due  = div_u64(mul_u64_u64_div_u64(gen->rate, ktime_to_ns(ktime_sub(ktime_get(), t0)), NSEC_PER_SEC),
+                           gen->len_rec) - n_due;
+        } else {
+            due  = U64_MAX;     /* as many as the mode takes */
+        }
+
+        if (dcb->mode == ZNDKCDEV_MODE_FIFO) {
+            done = _zndkcdev_gen_fifo(dcb, due);
+        } else if (dcb->mode != ZNDKCDEV_MODE_SHARD) {
+            done = _zndkcdev_gen_flat(dcb, due);
+        } else {
+            done = 0;           /* SHARD: per-CPU writers only */
+        }
+        WRITE_ONCE(gen->n_rec, gen->n_rec + done);
+        if (gen->rate != 0) {
+            WRITE_ONCE(gen->n_drop, gen->n_drop + (due - done));
+            n_due += due;
+        } else if (done > 0) {
+            cond_resched();     /* unpaced: straight on */
+            continue;
+        }
+
+        t_next = ktime_add_ns(t_next, period);
+        if (ktime_before(t_next, ktime_get())) {
+            t_next = ktime_add_ns(ktime_get(), period); /* behind: no back-to-back ticks, due catches up */
+        }
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (!kthread_should_stop()) {
+            schedule_hrtimeout_range(&t_next, period / 8, HRTIMER_MODE_ABS);
+        }
+        __set_current_state(TASK_RUNNING);
+    }
+
+    return  0;
+}
+
+/**
+ * zndkcdev_gen_start()
+ * @brief    start the synthetic producer of a device
+ * @dcb
+ * @gen      len_rec, period_us, cpu, rate
+ */
+static int
+zndkcdev_gen_start(TZndkCdevDCB *dcb, TZndkCdevGen *gen)
+{
+    struct task_struct *task;
+    int            stat = 0;
+
+    if ((gen->len_rec < (int)sizeof(TZndkCdevRec)) || (gen->len_rec > ZNDKCDEV_GEN_MAX_REC) ||
+        (gen->len_rec % 8) || (gen->period_us < 0) ||
+        ((gen->cpu >= 0) && ((gen->cpu >= nr_cpu_ids) || !cpu_online(gen->cpu)))) {
+        return  -EINVAL;
+    }
+
+    mutex_lock(&dcb->gen_mtx);
+    if (dcb->gen_task != NULL) {
+        stat = -EBUSY;
+        goto  start_unlock;
+    }
+    dcb->gen           = *gen;
+    dcb->gen.period_us = (gen->period_us != 0) ? gen->period_us : 100;
+    dcb->gen.n_rec     =  0;
+    dcb->gen.n_drop    =  0;
+    dcb->gen_seq       =  0;
+    dcb->gen_ofs       =  0;
+
+    task = kthread_create(zndkcdev_gen_thread, dcb, NAME_MODULE "_gen/%d", dcb->minor);
+    if (IS_ERR(task)) {
+        stat = PTR_ERR(task);
+        goto  start_unlock;
+    }
+    if (gen->cpu >= 0) {
+        kthread_bind(task, gen->cpu);
+    }
+    dcb->gen_task = task;
+    wake_up_process(task);
+
+start_unlock:
+    mutex_unlock(&dcb->gen_mtx);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_gen_stop()
+ * @brief    stop the synthetic producer of a device
+ * @dcb
+ * @gen      out: parameters and final counters
+ */
+static int
+zndkcdev_gen_stop(TZndkCdevDCB *dcb, TZndkCdevGen *gen)
+{
+    int            stat = 0;
+
+    mutex_lock(&dcb->gen_mtx);
+    if (dcb->gen_task == NULL) {
+        stat = -EINVAL;
+    } else {
+        kthread_stop(dcb->gen_task);
+        dcb->gen_task = NULL;
+        *gen          = dcb->gen;
+    }
+    mutex_unlock(&dcb->gen_mtx);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_llseek()
+ */
+static loff_t
+zndkcdev_llseek(struct file *filp, loff_t ofs, int whence)
+{
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(filp);
+    loff_t         pos;
+
+    if ((dcb->mode != ZNDKCDEV_MODE_FLAT) && (dcb->mode != ZNDKCDEV_MODE_FLIP)) {
+        return  -ESPIPE;        /* a pipe has no position */
+    }
+
+    switch (whence) {
+    case SEEK_SET:
+        pos     =  ofs;
+        break;
+    case SEEK_CUR:
+        pos     =  filp->f_pos  + ofs;
+        break;
+    case SEEK_END:
+        pos     = _zndkcdev_flat_len(dcb) + ofs;
+        break;
+    default:
+        return  -EINVAL;
+    }
+
+    if ((pos < 0) || (pos > _zndkcdev_flat_len(dcb))) {
+        return  -EINVAL;
+    }
+    filp->f_pos = pos;
+
+    return  pos;
+}
+
+/**
+ * _zndkcdev_read_iter()
+ */
+static ssize_t
+_zndkcdev_read_iter(TZndkCdevDCB *dcb, struct kiocb *iocb, struct iov_iter *to)
+{
+    ssize_t        stat  = 0;
+    size_t         count = iov_iter_count(to);
+    size_t         len;
+    loff_t         pos   = iocb->ki_pos;
+    long           base;
+    TZndkCdevRange rl;
+
+    pr_debug(" %s[%2d]: %s(): pos=%lld, count=%zu\n", NAME_MODULE, dcb->minor, __func__, pos, count);
+
+    if (dcb->mode == ZNDKCDEV_MODE_FIFO) {
+        return  zndkcdev_fifo_read(dcb, iocb, to);
+    }
+    if (dcb->mode == ZNDKCDEV_MODE_SHARD) {
+        return  zndkcdev_shard_drain(dcb, to, -1, _zndkcdev_nowait(iocb));
+    }
+
+    percpu_down_read(&dcb->buf_sem);
+
+    if ((count == 0) || (pos < 0) || (pos >= _zndkcdev_flat_len(dcb))) {
+        stat    = 0;            /* nothing to do or EOF */
+        goto  read_unlock;
+    }
+
+    len         = _zndkcdev_flat_len(dcb) - pos;
+    len         = (count < len) ? count : len;
+
+    base        = _zndkcdev_flat_lock(dcb, &rl, pos, len, 0);
+    if (base    <  0) {
+        stat    =  base;
+        goto  read_unlock;
+    }
+    stat        =  copy_to_iter(dcb->buf + base + pos, len, to); /* partial count on fault */
+    _zndkcdev_range_unlock(dcb, &rl);
+    if (stat   ==  0) {
+        stat    = -EFAULT;
+        goto  read_unlock;
+    }
+
+    iocb->ki_pos = pos + stat;
+
+read_unlock:
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_write_iter()
+ */
+static ssize_t
+_zndkcdev_write_iter(TZndkCdevDCB *dcb, struct kiocb *iocb, struct iov_iter *from)
+{
+    ssize_t        stat  = 0;
+    size_t         count = iov_iter_count(from);
+    size_t         len;
+    loff_t         pos   = iocb->ki_pos;
+    long           base;
+    TZndkCdevRange rl;
+
+    pr_debug(" %s[%2d]: %s(): pos=%lld, count=%zu\n", NAME_MODULE, dcb->minor, __func__, pos, count);
+
+    if (dcb->mode == ZNDKCDEV_MODE_FIFO) {
+        return  zndkcdev_fifo_write(dcb, iocb, from);
+    }
+    if (dcb->mode == ZNDKCDEV_MODE_SHARD) {
+        return  zndkcdev_shard_write(dcb, iocb, from);
+    }
+
+    percpu_down_read(&dcb->buf_sem);
+
+    if (count  == 0) {
+        stat    = 0;
+        goto  write_unlock;
+    }
+    if ((pos < 0) || (pos >= _zndkcdev_flat_len(dcb))) {
+        stat    = -ENOSPC;      /* no room left behind the end of buffer */
+        goto  write_unlock;
+    }
+
+    len         = _zndkcdev_flat_len(dcb) - pos;
+    len         = (count < len) ? count : len;
+
+    base        = _zndkcdev_flat_lock(dcb, &rl, pos, len, 1);
+    if (base    <  0) {
+        stat    =  base;
+        goto  write_unlock;
+    }
+    stat        =  copy_from_iter(dcb->buf + base + pos, len, from); /* partial count on fault */
+    _zndkcdev_range_unlock(dcb, &rl);
+    if (stat   ==  0) {
+        stat    = -EFAULT;
+        goto  write_unlock;
+    }
+
+    iocb->ki_pos = pos + stat;
+
+write_unlock:
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_read_iter()
+ * @brief    read(2)/readv(2)/pread(2)/io_uring: copy dcb->buf at ki_pos into the iovecs
+ */
+static ssize_t
+zndkcdev_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(iocb->ki_filp);
+    ktime_t        t0    = ktime_get();
+    ssize_t        stat;
+
+    stat = _zndkcdev_read_iter(dcb, iocb, to);
+    _zndkcdev_stat(dcb, ZNDKCDEV_STAT_READ , stat, (stat > 0) ? stat : 0, t0);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_write_iter()
+ * @brief    write(2)/writev(2)/pwrite(2)/io_uring: copy the iovecs into dcb->buf at ki_pos
+ */
+static ssize_t
+zndkcdev_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(iocb->ki_filp);
+    ktime_t        t0    = ktime_get();
+    ssize_t        stat;
+
+    stat = _zndkcdev_write_iter(dcb, iocb, from);
+    _zndkcdev_stat(dcb, ZNDKCDEV_STAT_WRITE, stat, (stat > 0) ? stat : 0, t0);
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_buf_page()
+ * @brief    page backing byte offset ofs of dcb->buf (4 KiB or 2 MiB buffer)
+ */
+static inline struct page *
+_zndkcdev_buf_page(TZndkCdevDCB *dcb, unsigned long ofs)
+{
+    if (dcb->hpages != NULL) {
+        return  nth_page(dcb->hpages[ofs >> PMD_SHIFT], (ofs & ~PMD_MASK) >> PAGE_SHIFT);
+    }
+
+    return  vmalloc_to_page(dcb->buf + ofs);
+}
+
+/**
+ * zndkcdev_spd_release()
+ * @brief    drop the reference of a page splice_to_pipe() didn't take
+ */
+static void
+zndkcdev_spd_release(struct splice_pipe_desc *spd, unsigned int idx)
+{
+    put_page(spd->pages[idx]);
+}
+
+/**
+ * _zndkcdev_splice_read()
+ * @brief    FLAT mode: hand the buffer pages themselves to the pipe (no copy)
+ * @note     like vmsplice(2), the pipe sees later writes to the range until
+ *           the reader consumes it; the page references keep the pages alive
+ *           across ZNDKCDEV_BUF_RESIZE
+ */
+static ssize_t
+_zndkcdev_splice_read(TZndkCdevDCB *dcb, loff_t *ppos, struct pipe_inode_info *pipe, size_t len)
+{
+    struct page        *pages  [PIPE_DEF_BUFFERS];
+    struct partial_page partial[PIPE_DEF_BUFFERS];
+    struct splice_pipe_desc spd = {
+        .pages          = pages  ,
+        .partial        = partial,
+        .nr_pages_max   = PIPE_DEF_BUFFERS,
+        .ops            = &nosteal_pipe_buf_ops,
+        .spd_release    = zndkcdev_spd_release,
+    };
+    loff_t              pos = *ppos;
+    unsigned long       pg_ofs;
+    size_t              n;
+    ssize_t             stat;
+
+    percpu_down_read(&dcb->buf_sem);
+    if ((pos < 0) || (pos >= dcb->len_buf)) {
+        percpu_up_read(&dcb->buf_sem);
+        return  0;              /* EOF */
+    }
+    len = min_t(size_t, len, dcb->len_buf - pos);
+    for (; (len > 0) && (spd.nr_pages < PIPE_DEF_BUFFERS); pos += n, len -= n) {
+        pg_ofs = pos & ~PAGE_MASK;
+        n      = min_t(size_t, len, PAGE_SIZE - pg_ofs);
+
+        pages  [spd.nr_pages]        = _zndkcdev_buf_page(dcb, pos);
+        partial[spd.nr_pages].offset = pg_ofs;
+        partial[spd.nr_pages].len    = n;
+        get_page(pages[spd.nr_pages]);
+        spd.nr_pages++;
+    }
+    percpu_up_read(&dcb->buf_sem);
+
+    stat = splice_to_pipe(pipe, &spd);
+    if (stat > 0) {
+        *ppos += stat;
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_splice_read()
+ * @brief    splice(2)/sendfile(2)/copy_file_range(2) from the device
+ *           FLAT       : zero-copy, the pipe refers to the buffer pages
+ *           FIFO/SHARD : consuming reads, through read_iter into pipe pages
+ */
+static ssize_t
+zndkcdev_splice_read(struct file *filp, loff_t *ppos, struct pipe_inode_info *pipe,
+                     size_t len, unsigned int flags)
+{
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(filp);
+    ktime_t        t0    = ktime_get();
+    ssize_t        stat;
+
+    if (dcb->mode != ZNDKCDEV_MODE_FLAT) {
+        return  copy_splice_read(filp, ppos, pipe, len, flags); /* read_iter counts it */
+    }
+
+    stat = _zndkcdev_splice_read(dcb, ppos, pipe, len);
+    _zndkcdev_stat(dcb, ZNDKCDEV_STAT_READ , stat, (stat > 0) ? stat : 0, t0);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_poll()
+ * @brief    readiness for poll/select/epoll
+ *
+ *  FLAT  mode: the buffer is always readable/writable.
+ *  FIFO  mode: EPOLLIN while data is queued, EPOLLOUT while space is left.
+ *  SHARD mode: EPOLLIN while any shard has data, EPOLLOUT while the shard of the
+ *              polling CPU has space (the one write(2) would pick from there;
+ *              a writer that migrates in between may still get -EAGAIN).
+ */
+static __poll_t
+zndkcdev_poll(struct file *filp, poll_table *wait)
+{
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(filp);
+    __poll_t       mask  = 0;
+    size_t         n_fifo;
+    int            is_full;
+    TZndkCdevShard *shard;
+
+    poll_wait(filp, &dcb->wq_rd, wait);
+    poll_wait(filp, &dcb->wq_wr, wait);
+
+    switch (READ_ONCE(dcb->mode)) {
+    case ZNDKCDEV_MODE_FIFO:
+        n_fifo  = READ_ONCE(dcb->fifo.n);
+        is_full = (n_fifo == dcb->fifo.len);
+        break;
+    case ZNDKCDEV_MODE_SHARD:
+        shard   = _zndkcdev_shard_cur(dcb);
+        n_fifo  = _zndkcdev_shard_queued(dcb);
+        is_full = (READ_ONCE(shard->ring.n) == shard->ring.len);
+        break;
+    default:
+        return  EPOLLIN | EPOLLRDNORM | EPOLLOUT | EPOLLWRNORM;
+    }
+
+    if (n_fifo != 0) {
+        mask  |= EPOLLIN  | EPOLLRDNORM;
+    }
+    if (!is_full) {
+        mask  |= EPOLLOUT | EPOLLWRNORM;
+    }
+
+    return  mask;
+}
+
+/**
+ * zndkcdev_vm_open()
+ * @brief    a mapping got duplicated (fork/split): count it
+ */
+static void
+zndkcdev_vm_open(struct vm_area_struct *vma)
+{
+    TZndkCdevDCB  *dcb     = (TZndkCdevDCB *)vma->vm_private_data;
+
+    atomic_inc(&dcb->n_mmap);
+}
+
+/**
+ * zndkcdev_vm_close()
+ * @brief    a mapping went away
+ */
+static void
+zndkcdev_vm_close(struct vm_area_struct *vma)
+{
+    TZndkCdevDCB  *dcb     = (TZndkCdevDCB *)vma->vm_private_data;
+
+    atomic_dec(&dcb->n_mmap);
+}
+
+/**
+ * _zndkcdev_huge_pfn()
+ * @brief    pfn backing byte offset ofs of a huge-page buffer
+ */
+static inline unsigned long
+_zndkcdev_huge_pfn(TZndkCdevDCB *dcb, unsigned long ofs)
+{
+    return  page_to_pfn(dcb->hpages[ofs >> PMD_SHIFT]) + ((ofs & ~PMD_MASK) >> PAGE_SHIFT);
+}
+
+/**
+ * zndkcdev_vm_fault()
+ * @brief    huge-page buffer: 4 KiB fallback (unaligned or partial PMD range)
+ */
+static vm_fault_t
+zndkcdev_vm_fault(struct vm_fault *vmf)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    TZndkCdevDCB  *dcb     = (TZndkCdevDCB *)vma->vm_private_data;
+    unsigned long  ofs     = (vmf->address & PAGE_MASK) - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT);
+
+    if ((dcb->hpages == NULL) || (ofs >= dcb->len_buf)) {
+        return  VM_FAULT_SIGBUS;
+    }
+    atomic_inc(&dcb->n_fault_pte);
+
+    return  vmf_insert_pfn(vma, vmf->address & PAGE_MASK, _zndkcdev_huge_pfn(dcb, ofs));
+}
+
+/**
+ * zndkcdev_vm_huge_fault()
+ * @brief    huge-page buffer: map a whole 2 MiB page w/ one PMD entry
+ */
+static vm_fault_t
+zndkcdev_vm_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    TZndkCdevDCB  *dcb     = (TZndkCdevDCB *)vma->vm_private_data;
+    unsigned long  addr    =  vmf->address & PMD_MASK;
+    unsigned long  ofs     =  addr - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT);
+
+    if ((order != PMD_SHIFT - PAGE_SHIFT) || (dcb->hpages == NULL)) {
+        return  VM_FAULT_FALLBACK;
+    }
+    if ((addr < vma->vm_start) || (addr + PMD_SIZE > vma->vm_end) ||
+        !IS_ALIGNED(ofs, PMD_SIZE) || (ofs + PMD_SIZE > dcb->len_buf)) {
+        return  VM_FAULT_FALLBACK;
+    }
+    atomic_inc(&dcb->n_fault_pmd);
+
+    return  vmf_insert_pfn_pmd(vmf, pfn_to_pfn_t(_zndkcdev_huge_pfn(dcb, ofs)),
+                               vmf->flags & FAULT_FLAG_WRITE);
+}
+
+/**
+ * zndkcdev_vm_ops
+ */
+static const struct vm_operations_struct zndkcdev_vm_ops = {
+    .open           = zndkcdev_vm_open ,
+    .close          = zndkcdev_vm_close,
+    .fault          = zndkcdev_vm_fault,
+    .huge_fault     = zndkcdev_vm_huge_fault,
+};
+
+/**
+ * _zndkcdev_mmap()
+ */
+static int
+_zndkcdev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    int            stat;
+    TZndkCdevDCB  *dcb     = _get_zndkcdev_filp_dcb(filp);
+    TZndkCdevCmdq *cmdq;
+    unsigned long  len_req;
+    unsigned long  ofs_req;
+
+    len_req = vma->vm_end - vma->vm_start;
+    ofs_req = vma->vm_pgoff << PAGE_SHIFT; /* window: mmap(2) offset into the buffer */
+
+    pr_info(" %s[%2d]: %s(): len_buf=%08X, mmap window requested:%08lX+%08lX\n",
+            NAME_MODULE, dcb->minor, __func__, dcb->len_buf, ofs_req, len_req);
+
+    if (ofs_req == ZNDKCDEV_CMDQ_OFS) {
+        /* command queue: always cached, freed at release() which the mapping defers */
+        cmdq = smp_load_acquire(&_get_zndkcdev_file(filp)->cmdq);
+        if ((cmdq == NULL) || (len_req > cmdq->len)) {
+            return  -EINVAL;
+        }
+        return  remap_vmalloc_range(vma, cmdq->hdr, 0);
+    }
+
+    if (ofs_req == ZNDKCDEV_FLIP_CTL_OFS) {
+        /* FLIP control page: read-only, lives as long as the dcb (the PTE holds a page ref) */
+        if ((len_req != PAGE_SIZE) || (vma->vm_flags & VM_WRITE)) {
+            return  -EINVAL;
+        }
+        vm_flags_clear(vma, VM_MAYWRITE);
+        return  vm_insert_page(vma, vma->vm_start, virt_to_page(dcb->flip));
+    }
+
+    /* serialize against ZNDKCDEV_BUF_RESIZE swapping dcb->buf */
+    if (mutex_lock_interruptible(&dcb->mtx)) {
+        return  -ERESTARTSYS;
+    }
+
+    if ((vma->vm_pgoff >= (dcb->len_buf >> PAGE_SHIFT)) || (len_req > dcb->len_buf - ofs_req)) {
+        mutex_unlock(&dcb->mtx);
+        pr_err(" %s():L%d: greed\n", __func__, __LINE__);
+        return -EAGAIN;
+    }
+
+    /* cache mode: buffer window only, the control page and cmdq stay cached (no PAT alias) */
+    switch (_get_zndkcdev_file(filp)->mmap_mode) {
+    case ZNDKCDEV_MMAP_WC:
+    case ZNDKCDEV_MMAP_UC:
+        if (dcb->hpages != NULL) {
+            /* PFN-mapped RAM keeps its write-back memtype: WC/UC would be ignored */
+            mutex_unlock(&dcb->mtx);
+            return  -EOPNOTSUPP;
+        }
+        vma->vm_page_prot = (_get_zndkcdev_file(filp)->mmap_mode == ZNDKCDEV_MMAP_WC) ?
+                            pgprot_writecombine(vma->vm_page_prot) : pgprot_noncached(vma->vm_page_prot);
+        break;
+    default:                    /* ZNDKCDEV_MMAP_WB: plain RAM, keep it cached */
+        break;
+    }
+
+    if (dcb->hpages != NULL) {
+        /* populated on fault only (MAP_POPULATE skips VM_PFNMAP): PMD entries where the 2 MiB window fits */
+        vm_flags_set(vma, VM_PFNMAP | VM_HUGEPAGE | VM_DONTEXPAND | VM_DONTDUMP);
+        stat = 0;
+    } else {
+        /* PTEs of the window only, installed now */
+        stat = remap_vmalloc_range(vma, dcb->buf, vma->vm_pgoff);
+    }
+    if (stat) {
+        mutex_unlock(&dcb->mtx);
+        pr_err(" %s[%2d]: %s():L%d: remap_vmalloc_range() failed = %d\n",
+               NAME_MODULE, dcb->minor, __func__, __LINE__, stat);
+        return -EAGAIN;
+    }
+
+    vma->vm_private_data = dcb;
+    vma->vm_ops          = &zndkcdev_vm_ops;
+    atomic_inc(&dcb->n_mmap);
+
+    mutex_unlock(&dcb->mtx);
+
+    return  0;
+}
+
+/**
+ * zndkcdev_mmap()
+ */
+static int
+zndkcdev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(filp);
+    ktime_t        t0    = ktime_get();
+    int            stat;
+
+    stat = _zndkcdev_mmap(filp, vma);
+    _zndkcdev_stat(dcb, ZNDKCDEV_STAT_MMAP, stat, vma->vm_end - vma->vm_start, t0);
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_xfer_ok()
+ * @brief    [ofs, ofs + len) lies in what flat R/W address; an empty range is refused
+ *           as it can't be range locked
+ */
+static inline bool
+_zndkcdev_xfer_ok(TZndkCdevDCB *dcb, int ofs, int len)
+{
+    return  (ofs >= 0) && (len > 0) && ((unsigned long)ofs + len <= _zndkcdev_flat_len(dcb));
+}
+
+/**
+ * zndkcdev_buf_rd()
+ * @dcb
+ * @mem
+ */
+static int
+zndkcdev_buf_rd(TZndkCdevDCB *dcb, TZndkCdevMem *mem)
+{
+    int     stat = 0;
+    int     ofs;
+    int     len;
+    long    base;
+    TZndkCdevRange rl;
+    ktime_t t0   = ktime_get();
+
+    len  = 0;
+    percpu_down_read(&dcb->buf_sem);
+    if (_zndkcdev_xfer_ok(dcb, mem->ofs, mem->len)) {
+        /* correct params */
+        ofs      =  mem->ofs;
+        len      =  mem->len;
+
+        base     = _zndkcdev_flat_lock(dcb, &rl, ofs, len, 0);
+        if (base <  0) {
+            stat = -ERESTARTSYS;
+        } else {
+            ofs += base;
+            if (copy_to_user((char *)mem->buf, (char *)(dcb->buf + ofs), len)) {
+                stat = -1;
+            }
+            _zndkcdev_range_unlock(dcb, &rl);
+        }
+    } else {
+        pr_err(" %s[%2d]: %s(): out of range: ofs + len must be in (0, %d] (your: %d + %d)\n",
+               NAME_MODULE, dcb->minor, __func__, (int)_zndkcdev_flat_len(dcb), mem->ofs, mem->len);
+        stat = -2;
+    }
+    percpu_up_read(&dcb->buf_sem);
+    _zndkcdev_stat(dcb, ZNDKCDEV_STAT_BUF_RD, stat, len, t0);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_wr()
+ * @dcb
+ * @mem
+ */
+static int
+zndkcdev_buf_wr(TZndkCdevDCB *dcb, TZndkCdevMem *mem)
+{
+    int     stat = 0;
+    int     ofs;
+    int     len;
+    long    base;
+    TZndkCdevRange rl;
+    ktime_t t0   = ktime_get();
+
+    len  = 0;
+    percpu_down_read(&dcb->buf_sem);
+    if (_zndkcdev_xfer_ok(dcb, mem->ofs, mem->len)) {
+        /* correct params */
+        ofs      =  mem->ofs;
+        len      =  mem->len;
+
+        base     = _zndkcdev_flat_lock(dcb, &rl, ofs, len, 1);
+        if (base <  0) {
+            stat = -ERESTARTSYS;
+        } else {
+            ofs += base;
+            if (copy_from_user((char *)(dcb->buf + ofs), (char *)mem->buf, len)) {
+                stat = -1;
+            }
+            _zndkcdev_range_unlock(dcb, &rl);
+        }
+    } else {
+        pr_err(" %s[%2d]: %s(): out of range: ofs + len must be in (0, %d] (your: %d + %d)\n",
+               NAME_MODULE, dcb->minor, __func__, (int)_zndkcdev_flat_len(dcb), mem->ofs, mem->len);
+        stat = -2;
+    }
+    percpu_up_read(&dcb->buf_sem);
+    _zndkcdev_stat(dcb, ZNDKCDEV_STAT_BUF_WR, stat, len, t0);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_csum()
+ * @brief    checksum [ofs, ofs + len) in place (no copy to user space); the range
+ *           is addressed and locked (shared) as BUF_RD does, the front frame in FLIP mode
+ * @dcb
+ * @csum
+ */
+static int
+zndkcdev_buf_csum(TZndkCdevDCB *dcb, TZndkCdevCsum *csum)
+{
+    struct xxh64_state xs;
+    TZndkCdevRange rl;
+    const char    *p;
+    u32            crc  = ~(u32)csum->seed;
+    long           base;
+    size_t         n;
+    size_t         remain;
+    int            stat = 0;
+
+    if ((csum->algo != ZNDKCDEV_CSUM_CRC32C) && (csum->algo != ZNDKCDEV_CSUM_XXH64)) {
+        return  -EINVAL;
+    }
+
+    percpu_down_read(&dcb->buf_sem);
+    if (!_zndkcdev_xfer_ok(dcb, csum->ofs, csum->len)) {
+        stat = -EINVAL;
+        goto  csum_unlock;
+    }
+
+    base = _zndkcdev_flat_lock(dcb, &rl, csum->ofs, csum->len, 0);
+    if (base < 0) {
+        stat = base;
+        goto  csum_unlock;
+    }
+
+    xxh64_reset(&xs, csum->seed);
+    p      = dcb->buf + base + csum->ofs;
+    remain = csum->len;
+    for (; remain > 0; p += n, remain -= n) {
+        n = min_t(size_t, remain, SZ_1M); /* big ranges: let others run in between */
+        if (csum->algo == ZNDKCDEV_CSUM_CRC32C) {
+            crc = crc32c(crc, p, n);
+        } else {
+            xxh64_update(&xs, p, n);
+        }
+        cond_resched();
+    }
+    csum->csum = (csum->algo == ZNDKCDEV_CSUM_CRC32C) ? (u64)~crc : xxh64_digest(&xs);
+
+    _zndkcdev_range_unlock(dcb, &rl);
+
+csum_unlock:
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+}
+
+/**
+ * _zndkcdev_memmove()
+ * @brief    memmove()/memset() (src == NULL) in 1 MiB steps, rescheduling in between
+ */
+static void
+_zndkcdev_memmove(char *dst, const char *src, size_t len, int val)
+{
+    size_t         n;
+
+    if ((src == NULL) || (dst <= src)) {
+        for (; len > 0; dst += n, src = src ? src + n : NULL, len -= n) {
+            n = min_t(size_t, len, SZ_1M);
+            if (src == NULL) {
+                memset (dst, val, n);
+            } else {
+                memmove(dst, src, n);
+            }
+            cond_resched();
+        }
+    } else {
+        for (; len > 0; len -= n) { /* overlap w/ dst above src: back to front */
+            n = min_t(size_t, len, SZ_1M);
+            memmove(dst + len - n, src + len - n, n);
+            cond_resched();
+        }
+    }
+}
+
+/**
+ * zndkcdev_buf_fill()
+ * @brief    memset [dst_ofs, dst_ofs + len) to val, addressed/locked as BUF_WR
+ * @dcb
+ * @xf
+ */
+static int
+zndkcdev_buf_fill(TZndkCdevDCB *dcb, TZndkCdevXfer *xf)
+{
+    TZndkCdevRange rl;
+    long           base;
+    int            stat = 0;
+
+    percpu_down_read(&dcb->buf_sem);
+    if (!_zndkcdev_xfer_ok(dcb, xf->dst_ofs, xf->len)) {
+        stat = -EINVAL;
+        goto  fill_unlock;
+    }
+    base = _zndkcdev_flat_lock(dcb, &rl, xf->dst_ofs, xf->len, 1);
+    if (base < 0) {
+        stat = base;
+        goto  fill_unlock;
+    }
+    _zndkcdev_memmove(dcb->buf + base + xf->dst_ofs, NULL, xf->len, xf->val);
+    _zndkcdev_range_unlock(dcb, &rl);
+
+fill_unlock:
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_move()
+ * @brief    memmove [src_ofs, src_ofs + len) to dst_ofs in the same buffer (ranges may
+ *           overlap); both are addressed as BUF_WR (the back frame in FLIP mode)
+ * @dcb
+ * @xf
+ */
+static int
+zndkcdev_buf_move(TZndkCdevDCB *dcb, TZndkCdevXfer *xf)
+{
+    TZndkCdevRange rl;
+    int            lo   = min(xf->src_ofs, xf->dst_ofs);
+    long           base;
+    int            stat = 0;
+
+    percpu_down_read(&dcb->buf_sem);
+    if (!_zndkcdev_xfer_ok(dcb, xf->src_ofs, xf->len) || !_zndkcdev_xfer_ok(dcb, xf->dst_ofs, xf->len)) {
+        stat = -EINVAL;
+        goto  move_unlock;
+    }
+    /* one exclusive lock over the union: nobody sees a half-moved range */
+    base = _zndkcdev_flat_lock(dcb, &rl, lo, max(xf->src_ofs, xf->dst_ofs) + xf->len - lo, 1);
+    if (base < 0) {
+        stat = base;
+        goto  move_unlock;
+    }
+    _zndkcdev_memmove(dcb->buf + base + xf->dst_ofs, dcb->buf + base + xf->src_ofs, xf->len, 0);
+    _zndkcdev_range_unlock(dcb, &rl);
+
+move_unlock:
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_copy()
+ * @brief    copy [src_ofs, src_ofs + len) of minor src_minor (as BUF_RD there) to
+ *           dst_ofs of dcb (as BUF_WR)
+ * @dcb
+ * @xf
+ * @note     the source is pinned w/ n_open like an open file so it can't be destroyed,
+ *           and its buf_sem is held for read so it can be neither resized nor switched
+ *           to another mode meanwhile; the buf_sems and the range locks of the two
+ *           devices are taken in minor order, so opposite copies can't deadlock
+ *           (each dcb has its own lockdep class for buf_sem, so lockdep sees no recursion)
+ */
+static int
+zndkcdev_buf_copy(TZndkCdevDCB *dcb, TZndkCdevXfer *xf)
+{
+    TZndkCdevInfo *info = _get_zndkcdev_info();
+    TZndkCdevDCB  *src;
+    TZndkCdevRange rl_src;
+    TZndkCdevRange rl_dst;
+    long           base_src = 0;
+    long           base_dst = 0;
+    int            stat     = 0;
+
+    if ((xf->src_ofs < 0) || (xf->src_minor < 0) || (xf->src_minor >= ZNDKCDEV_MAX_DEV)) {
+        return  -EINVAL;
+    }
+    if (xf->src_minor == dcb->minor) {
+        return  zndkcdev_buf_move(dcb, xf);
+    }
+
+    mutex_lock(&info->mtx);
+    src = _get_zndkcdev_dcb(xf->src_minor);
+    if (src != NULL) {
+        atomic_inc(&src->n_open);
+    }
+    mutex_unlock(&info->mtx);
+    if (src == NULL) {
+        return  -ENODEV;
+    }
+
+    if (src->minor < dcb->minor) {
+        percpu_down_read(&src->buf_sem);
+        percpu_down_read(&dcb->buf_sem);
+    } else {
+        percpu_down_read(&dcb->buf_sem);
+        percpu_down_read(&src->buf_sem);
+    }
+    if (!_zndkcdev_xfer_ok(src, xf->src_ofs, xf->len) || !_zndkcdev_xfer_ok(dcb, xf->dst_ofs, xf->len)) {
+        stat = -EINVAL;
+        goto  copy_unlock;
+    }
+
+    if (src->minor < dcb->minor) {
+        base_src = _zndkcdev_flat_lock(src, &rl_src, xf->src_ofs, xf->len, 0);
+        if (base_src >= 0) {
+            base_dst = _zndkcdev_flat_lock(dcb, &rl_dst, xf->dst_ofs, xf->len, 1);
+            if (base_dst < 0) {
+                _zndkcdev_range_unlock(src, &rl_src);
+            }
+        }
+    } else {
+        base_dst = _zndkcdev_flat_lock(dcb, &rl_dst, xf->dst_ofs, xf->len, 1);
+        if (base_dst >= 0) {
+            base_src = _zndkcdev_flat_lock(src, &rl_src, xf->src_ofs, xf->len, 0);
+            if (base_src < 0) {
+                _zndkcdev_range_unlock(dcb, &rl_dst);
+            }
+        }
+    }
+    if ((base_src < 0) || (base_dst < 0)) {
+        stat = -ERESTARTSYS;
+        goto  copy_unlock;
+    }
+
+    _zndkcdev_memmove(dcb->buf + base_dst + xf->dst_ofs, src->buf + base_src + xf->src_ofs, xf->len, 0);
+    _zndkcdev_range_unlock(dcb, &rl_dst);
+    _zndkcdev_range_unlock(src, &rl_src);
+
+copy_unlock:
+    percpu_up_read(&src->buf_sem);
+    percpu_up_read(&dcb->buf_sem);
+    atomic_dec(&src->n_open);
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_sync()
+ * @brief    make CPU writes to {ofs, len} visible to non-cached observers; the range
+ *           is addressed as BUF_WR does (the back frame in FLIP mode)
+ * @dcb
+ * @mem      {-, ofs, len}
+ * @return   -EOPNOTSUPP where the kernel offers modules no cache maintenance
+ */
+static int
+zndkcdev_buf_sync(TZndkCdevDCB *dcb, TZndkCdevMem *mem)
+{
+#ifdef CONFIG_X86
+    int            stat = 0;
+    long           base;
+    TZndkCdevRange rl;
+
+    percpu_down_read(&dcb->buf_sem);
+    if (!_zndkcdev_xfer_ok(dcb, mem->ofs, mem->len)) {
+        stat = -EINVAL;
+    } else {
+        base = _zndkcdev_flat_lock(dcb, &rl, mem->ofs, mem->len, 1);
+        if (base < 0) {
+            stat = -ERESTARTSYS;
+        } else {
+            mb();               /* order prior stores before the flush */
+            clflush_cache_range(dcb->buf + base + mem->ofs, mem->len);
+            _zndkcdev_range_unlock(dcb, &rl);
+        }
+    }
+    percpu_up_read(&dcb->buf_sem);
+
+    return  stat;
+#else
+    return  -EOPNOTSUPP;        /* a barrier alone would flush nothing */
+#endif
+}
+
+/**
+ * zndkcdev_buf_resize()
+ * @brief    replace the buffer of an idle device (no other opener, no mapping)
+ * @dcb
+ * @len      new buffer size [B], rounded up to pages
+ */
+static int
+zndkcdev_buf_resize(TZndkCdevDCB *dcb, unsigned long len)
+{
+    int            stat  = 0;
+    char          *buf;
+    struct page  **hpages;
+    unsigned long  len_old = 0;
+
+    if ((len < PAGE_SIZE) || (len > ZNDKCDEV_MAX_BUF)) {
+        return  -EINVAL;
+    }
+
+    buf = _zndkcdev_buf_alloc(&len, &hpages);
+    if (buf == NULL) {
+        return  -ENOMEM;
+    }
+
+    if (mutex_lock_interruptible(&dcb->mtx)) {
+        _zndkcdev_buf_free(buf, len, hpages);
+        return  -ERESTARTSYS;
+    }
+
+    if ((atomic_read(&dcb->n_open) > 1) || (atomic_read(&dcb->n_mmap) > 0)) {
+        stat = -EBUSY;
+        goto  resize_unlock;
+    }
+
+    percpu_down_write(&dcb->buf_sem); /* drain in-flight R/W on the old buffer */
+    swap(dcb->buf   , buf   );  /* old buffer is freed below */
+    swap(dcb->hpages, hpages);
+    len_old        =  dcb->len_buf;
+    dcb->len_buf   =  len;
+    _zndkcdev_flip_ctl_update(dcb);
+    percpu_up_write(&dcb->buf_sem);
+    _zndkcdev_ring_init(&dcb->fifo, dcb->buf, dcb->len_buf); /* FIFO/SHARD content is dropped */
+    _zndkcdev_shard_reset(dcb);
+
+    pr_info(" %s[%2d]: %s(): len_buf=%08X\n", NAME_MODULE, dcb->minor, __func__, dcb->len_buf);
+
+resize_unlock:
+    mutex_unlock(&dcb->mtx);
+    _zndkcdev_buf_free(buf, (stat == 0) ? len_old : len, hpages);
+
+    return  stat;
+}
+
+/**
+ * @struct TZndkCdevDmabuf
+ * @brief  one exported [ofs, ofs + len) of dcb->buf
+ */
+typedef struct {
+    TZndkCdevDCB   *dcb;
+    unsigned long   ofs;
+    unsigned long   n_pages;
+    struct page   **pages;             /* pages backing the range */
+} TZndkCdevDmabuf;
+
+/**
+ * zndkcdev_dmabuf_map()
+ * @brief    importer wants DMA addresses: sg_table of the range's pages
+ */
+static struct sg_table *
+zndkcdev_dmabuf_map(struct dma_buf_attachment *attach, enum dma_data_direction dir)
+{
+    TZndkCdevDmabuf *db  = attach->dmabuf->priv;
+    struct sg_table *sgt;
+    int              stat;
+
+    sgt = kzalloc(sizeof(struct sg_table), GFP_KERNEL);
+    if (sgt == NULL) {
+        return  ERR_PTR(-ENOMEM);
+    }
+    stat = sg_alloc_table_from_pages(sgt, db->pages, db->n_pages, 0,
+                                     db->n_pages << PAGE_SHIFT, GFP_KERNEL);
+    if (stat == 0) {
+        stat = dma_map_sgtable(attach->dev, sgt, dir, 0);
+        if (stat != 0) {
+            sg_free_table(sgt);
+        }
+    }
+    if (stat != 0) {
+        kfree(sgt);
+        return  ERR_PTR(stat);
+    }
+
+    return  sgt;
+}
+
+/**
+ * zndkcdev_dmabuf_unmap()
+ */
+static void
+zndkcdev_dmabuf_unmap(struct dma_buf_attachment *attach, struct sg_table *sgt,
+                      enum dma_data_direction dir)
+{
+    dma_unmap_sgtable(attach->dev, sgt, dir, 0);
+    sg_free_table(sgt);
+    kfree(sgt);
+}
+
+/**
+ * zndkcdev_dmabuf_mmap()
+ * @brief    mmap(2) of the dma-buf fd: insert the range's pages (vm_pgoff honored)
+ */
+static int
+zndkcdev_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+    TZndkCdevDmabuf *db  = dmabuf->priv;
+
+    return  vm_map_pages(vma, db->pages, db->n_pages);
+}
+
+/**
+ * zndkcdev_dmabuf_vmap()
+ * @brief    kernel importers: dcb->buf is already mapped contiguously
+ */
+static int
+zndkcdev_dmabuf_vmap(struct dma_buf *dmabuf, struct iosys_map *map)
+{
+    TZndkCdevDmabuf *db  = dmabuf->priv;
+
+    iosys_map_set_vaddr(map, db->dcb->buf + db->ofs);
+
+    return  0;
+}
+
+/**
+ * zndkcdev_dmabuf_release()
+ * @brief    last reference to the dma-buf is gone: the buffer may be resized/destroyed again
+ */
+static void
+zndkcdev_dmabuf_release(struct dma_buf *dmabuf)
+{
+    TZndkCdevDmabuf *db  = dmabuf->priv;
+
+    atomic_dec(&db->dcb->n_mmap);
+    kvfree(db->pages);
+    kfree(db);
+}
+
+/**
+ * zndkcdev_dmabuf_ops
+ */
+static const struct dma_buf_ops zndkcdev_dmabuf_ops = {
+    .map_dma_buf    = zndkcdev_dmabuf_map    ,
+    .unmap_dma_buf  = zndkcdev_dmabuf_unmap  ,
+    .mmap           = zndkcdev_dmabuf_mmap   ,
+    .vmap           = zndkcdev_dmabuf_vmap   ,
+    .release        = zndkcdev_dmabuf_release,
+};
+
+/**
+ * zndkcdev_export_dmabuf()
+ * @brief    export [mem->ofs, mem->ofs + mem->len) of dcb->buf as a dma-buf
+ * @dcb
+ * @mem      ofs/len: page aligned, within the buffer (buf: unused)
+ * @return   dma-buf fd (O_CLOEXEC) or -errno
+ * @note     a dma-buf counts as a live mapping: the buffer can't be resized
+ *           or destroyed (and the module stays loaded) until it's released
+ */
+static int
+zndkcdev_export_dmabuf(TZndkCdevDCB *dcb, TZndkCdevMem *mem)
+{
+    DEFINE_DMA_BUF_EXPORT_INFO(info);
+    TZndkCdevDmabuf *db;
+    struct dma_buf  *dmabuf;
+    unsigned long    ofs;
+    unsigned long    idx;
+    int              fd;
+
+    if ((mem->ofs < 0) || (mem->len <= 0) ||
+        !PAGE_ALIGNED(mem->ofs) || !PAGE_ALIGNED(mem->len)) {
+        return  -EINVAL;
+    }
+
+    db = kzalloc(sizeof(TZndkCdevDmabuf), GFP_KERNEL);
+    if (db == NULL) {
+        return  -ENOMEM;
+    }
+    db->dcb     = dcb;
+    db->ofs     = mem->ofs;
+    db->n_pages = mem->len >> PAGE_SHIFT;
+    db->pages   = kvcalloc(db->n_pages, sizeof(struct page *), GFP_KERNEL);
+    if (db->pages == NULL) {
+        kfree(db);
+        return  -ENOMEM;
+    }
+
+    /* serialize against ZNDKCDEV_BUF_RESIZE swapping dcb->buf */
+    if (mutex_lock_interruptible(&dcb->mtx)) {
+        fd = -ERESTARTSYS;
+        goto  export_free;
+    }
+    if (db->ofs + ((unsigned long)db->n_pages << PAGE_SHIFT) > dcb->len_buf) {
+        fd = -EINVAL;
+        goto  export_unlock;
+    }
+    for (idx = 0; idx < db->n_pages; idx++) {
+        ofs = db->ofs + (idx << PAGE_SHIFT);
+        db->pages[idx] = _zndkcdev_buf_page(dcb, ofs);
     }
 
-    buf         =  dcb->buf;
-    len         = (count < dcb->len_buf) ? count : dcb->len_buf;
+    info.exp_name = NAME_MODULE;
+    info.owner    = THIS_MODULE;
+    info.ops      = &zndkcdev_dmabuf_ops;
+    info.size     = db->n_pages << PAGE_SHIFT;
+    info.flags    = O_RDWR;
+    info.priv     = db;
+    dmabuf = dma_buf_export(&info);
+    if (IS_ERR(dmabuf)) {
+        fd = PTR_ERR(dmabuf);
+        goto  export_unlock;
+    }
+    atomic_inc(&dcb->n_mmap);   /* dropped by zndkcdev_dmabuf_release() */
+    mutex_unlock(&dcb->mtx);
 
-    remain      =  copy_to_user(ubuf, buf, len);
-    if (remain !=  0) {
-        stat    =  0;
-        goto  read_unlock;
+    fd = dma_buf_fd(dmabuf, O_CLOEXEC);
+    if (fd < 0) {
+        dma_buf_put(dmabuf);    /* frees db */
     }
 
-    stat        =  len;
+    return  fd;
 
-read_unlock:
-//    mutex_unlock(&dcb->mtx);
+export_unlock:
+    mutex_unlock(&dcb->mtx);
+export_free:
+    kvfree(db->pages);
+    kfree(db);
 
-    return  stat;
+    return  fd;
 }
 
 /**
- * zndkcdev_write()
+ * zndkcdev_get_feature()
+ * @dcb
+ * @feat
  */
-static ssize_t
-zndkcdev_write(struct file *filp, const char __user *ubuf, size_t count, loff_t *fpos)
+static int
+zndkcdev_get_feature(TZndkCdevDCB *dcb, TZndkCdevFeature *feat)
 {
-    int            stat  = 0;
-    TZndkCdevDCB  *dcb   = (TZndkCdevDCB *)filp->private_data;
-    size_t         len;
-    size_t         remain;
-    void          *buf;
+    TZndkCdevInfo *info  = _get_zndkcdev_info();
 
-    pr_info(" %s[%2d]: %s()\n", NAME_MODULE, dcb->minor, __func__);
+    memset(feat, 0, sizeof(TZndkCdevFeature));
+    memcpy(feat->ver, info->ver, sizeof(feat->ver));
+    feat->n_dev       = info->n_dev;
+    feat->len_buf     = dcb->len_buf;
+    feat->map_size    = (dcb->hpages != NULL) ? PMD_SIZE : PAGE_SIZE;
+    feat->flags       = (dcb->hpages != NULL) ? ZNDKCDEV_FEAT_HUGE_PMD : 0;
+    feat->n_fault_pmd = atomic_read(&dcb->n_fault_pmd);
+    feat->n_fault_pte = atomic_read(&dcb->n_fault_pte);
+    feat->n_shard     = dcb->n_shard;
 
-//    if (mutex_lock_interruptible(&dcb->mtx)) {
-//        return  -ERESTARTSYS;
-//    }
+    return  0;
+}
 
-    if (*fpos  >= dcb->len_buf) {
-        stat    = 0;
-        goto  read_unlock;
+/**
+ * _zndkcdev_buf_errno()
+ * @brief    result of zndkcdev_buf_(rd|wr)() as -errno
+ */
+static inline int
+_zndkcdev_buf_errno(int stat)
+{
+    switch (stat) {
+    case  0          : return  0;
+    case -1          : return -EFAULT;
+    case -2          : return -EINVAL;
+    case -ERESTARTSYS: return -EINTR;
+    default          : return  stat;
     }
+}
 
-    buf         =  dcb->buf;
-    len         = (count < dcb->len_buf) ? count : dcb->len_buf;
-
-    remain      =  copy_from_user(buf, ubuf, len);
-    if (remain !=  0) {
-        stat    =  0;
-        goto  read_unlock;
+/**
+ * zndkcdev_buf_rwv()
+ * @brief    scatter/gather a batch of segments in one ioctl
+ * @dcb
+ * @vec
+ * @is_wr    0: zndkcdev_buf_rd(), 1: zndkcdev_buf_wr()
+ *
+ * segments are fetched ZNDKCDEV_MEMVEC_CHUNK at a time onto the stack,
+ * each one gets its own result code (0 or -errno) in vec->stat[].
+ */
+static int
+zndkcdev_buf_rwv(TZndkCdevDCB *dcb, TZndkCdevMemVec *vec, int is_wr)
+{
+    TZndkCdevMem   mem [ZNDKCDEV_MEMVEC_CHUNK];
+    int            rslt[ZNDKCDEV_MEMVEC_CHUNK];
+    TZndkCdevMem __user *umem  = (TZndkCdevMem __user *)vec->mem;
+    int          __user *ustat = (int          __user *)vec->stat;
+    int            n_err = 0;
+    int            idx;
+    int            n;
+    int            i;
+
+    if ((vec->n_mem < 0) || (vec->n_mem > ZNDKCDEV_MEMVEC_MAX)) {
+        return  -EINVAL;
     }
 
-    stat        =  len;
+    for (idx = 0; idx < vec->n_mem; idx += n) {
+        n = vec->n_mem - idx;
+        n = (n < ZNDKCDEV_MEMVEC_CHUNK) ? n : ZNDKCDEV_MEMVEC_CHUNK;
 
-read_unlock:
-//    mutex_unlock(&dcb->mtx);
+        if (copy_from_user(mem, umem + idx, n * sizeof(TZndkCdevMem))) {
+            return  -EFAULT;
+        }
+        for (i = 0; i < n; i++) {
+            rslt[i] = _zndkcdev_buf_errno((is_wr) ? zndkcdev_buf_wr(dcb, &mem[i]) : zndkcdev_buf_rd(dcb, &mem[i]));
+            if (rslt[i] != 0) {
+                n_err++;
+            }
+        }
+        if ((ustat != NULL) && copy_to_user(ustat + idx, rslt, n * sizeof(int))) {
+            return  -EFAULT;
+        }
+    }
 
-    return  stat;
+    return  n_err;
 }
 
 /**
- * zndkcdev_mmap()
+ * _zndkcdev_cmdq_exec()
+ * @brief    run one command as its ioctl counterpart does
+ * @return   0 or -errno; *val: checksum of ZNDKCDEV_OP_BUF_CSUM
  */
 static int
-zndkcdev_mmap(struct file *filp, struct vm_area_struct *vma)
+_zndkcdev_cmdq_exec(TZndkCdevCmdq *cmdq, const TZndkCdevSqe *sqe, unsigned long long *val)
 {
+    TZndkCdevDCB  *dcb    = cmdq->dcb;
+    TZndkCdevMem   mem    = { (void *)(unsigned long)sqe->addr, sqe->ofs, sqe->len };
+    TZndkCdevXfer  xf     = { sqe->ofs, 0, sqe->len, sqe->val, 0 };
+    TZndkCdevCsum  csum   = { sqe->ofs, sqe->len, sqe->val, 0, sqe->addr, 0 };
+    TSigMsg        sigmsg = { (pid_t)sqe->addr, sqe->val };
+    ktime_t        t0     = ktime_get();
     int            stat;
-    TZndkCdevDCB  *dcb     = (TZndkCdevDCB *)filp->private_data;
-    unsigned long  len_req;
 
-    len_req = vma->vm_end - vma->vm_start;
+    *val = 0;
+    switch (sqe->op) {
+    case ZNDKCDEV_OP_NOP     :
+        return  0;
+    case ZNDKCDEV_OP_BUF_RD  :
+        return  _zndkcdev_buf_errno(zndkcdev_buf_rd(dcb, &mem));
+    case ZNDKCDEV_OP_BUF_WR  :
+        return  _zndkcdev_buf_errno(zndkcdev_buf_wr(dcb, &mem));
+    case ZNDKCDEV_OP_BUF_FILL:
+        stat = zndkcdev_buf_fill(dcb, &xf);
+        _zndkcdev_stat(dcb, ZNDKCDEV_STAT_FILL, stat, (stat == 0) ? xf.len : 0, t0);
+        return  stat;
+    case ZNDKCDEV_OP_BUF_CSUM:
+        stat = zndkcdev_buf_csum(dcb, &csum);
+        *val = csum.csum;
+        return  stat;
+    case ZNDKCDEV_OP_NOTIFY  :
+        stat = zndkcdev_send_signal(dcb, &sigmsg, cmdq->pid_ns); /* the poller lives in init_pid_ns */
+        _zndkcdev_stat(dcb, ZNDKCDEV_STAT_SIGNAL, stat, 0, t0);
+        return  stat;
+    default:
+        return  -EINVAL;
+    }
+}
 
-    pr_info(" %s[%2d]: %s(): len_buf=%08X, mmap size requested:%08lX\n",
-            NAME_MODULE, dcb->minor, __func__, LEN_ZNDKCDEV_BUF, len_req);
+/**
+ * _zndkcdev_cmdq_run()
+ * @brief    consume the SQ up to sq_tail, posting one CQE per command
+ * @return   # of commands run (a full CQ ends the batch early)
+ * @note     one consumer at a time: the poller, or ENTER under cmdq->mtx
+ */
+static int
+_zndkcdev_cmdq_run(TZndkCdevCmdq *cmdq)
+{
+    TZndkCdevCmdqHdr *hdr     = cmdq->hdr;
+    u32               sq_tail = smp_load_acquire(&hdr->sq_tail); /* SQEs before it are filled */
+    TZndkCdevSqe      sqe;
+    TZndkCdevCqe     *cqe;
+    int               n;
+
+    for (n = 0; (cmdq->sq_head != sq_tail) && (n <= cmdq->sq_mask); n++) {
+        if (cmdq->cq_tail - smp_load_acquire(&hdr->cq_head) > cmdq->cq_mask) {
+            WRITE_ONCE(hdr->n_cq_full, hdr->n_cq_full + 1);
+            break;
+        }
 
-    if (len_req > LEN_ZNDKCDEV_BUF) {
-        pr_err(" %s():L%d: greed\n", __func__, __LINE__);
-        return -EAGAIN;
+        /* the SQE is shared w/ user space: take one snapshot, then hand the slot back */
+        memcpy(&sqe, &cmdq->sqes[cmdq->sq_head & cmdq->sq_mask], sizeof(TZndkCdevSqe));
+        smp_store_release(&hdr->sq_head, ++cmdq->sq_head);
+
+        cqe            = &cmdq->cqes[cmdq->cq_tail & cmdq->cq_mask];
+        cqe->user_data = sqe.user_data;
+        cqe->res       = _zndkcdev_cmdq_exec(cmdq, &sqe, &cqe->val);
+        smp_store_release(&hdr->cq_tail, ++cmdq->cq_tail); /* publish the CQE */
     }
 
-    vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
-    stat = remap_pfn_range(vma,
-                           vma->vm_start,
-                           virt_to_phys(dcb->buf) >> PAGE_SHIFT,
-                           len_req,
-                           vma->vm_page_prot);
+    return  n;
+}
 
-    if (stat) {
-        pr_err(" %s[%2d]: %s():L%d: remap_pfn_range() failed = %d\n",
-               NAME_MODULE, dcb->minor, __func__, __LINE__, stat);
-        return -EAGAIN;
+/**
+ * zndkcdev_cmdq_poller()
+ * @brief    SQ polling thread: runs commands as they get posted w/o any syscall;
+ *           after idle jiffies w/o work it sets ZNDKCDEV_CMDQ_NEED_WAKEUP and
+ *           sleeps until ZNDKCDEV_CMDQ_ENTER
+ */
+static int
+zndkcdev_cmdq_poller(void *arg)
+{
+    TZndkCdevCmdq    *cmdq   = (TZndkCdevCmdq *)arg;
+    TZndkCdevCmdqHdr *hdr    = cmdq->hdr;
+    unsigned long     t_idle = jiffies + cmdq->idle;
+
+    while (!kthread_should_stop()) {
+        if (READ_ONCE(hdr->sq_tail) != cmdq->sq_head) {
+            if (!mmget_not_zero(cmdq->mm)) {
+                /* the submitter is exiting: its buffers are gone, wait for release() */
+                set_current_state(TASK_INTERRUPTIBLE);
+                if (!kthread_should_stop()) {
+                    schedule();
+                }
+                __set_current_state(TASK_RUNNING);
+                continue;
+            }
+            kthread_use_mm(cmdq->mm); /* BUF_RD/WR: addr is in the submitter's address space */
+            _zndkcdev_cmdq_run(cmdq);
+            kthread_unuse_mm(cmdq->mm);
+            mmput(cmdq->mm);
+            t_idle = jiffies + cmdq->idle;
+        } else if (time_before(jiffies, t_idle)) {
+            cpu_relax();
+        } else {
+            set_current_state(TASK_INTERRUPTIBLE);
+            WRITE_ONCE(hdr->flags, hdr->flags |  ZNDKCDEV_CMDQ_NEED_WAKEUP);
+            smp_mb();           /* flag, then sq_tail: pairs w/ the submitter's sq_tail, then flag */
+            if ((READ_ONCE(hdr->sq_tail) == cmdq->sq_head) && !kthread_should_stop()) {
+                schedule();
+            }
+            __set_current_state(TASK_RUNNING);
+            WRITE_ONCE(hdr->flags, hdr->flags & ~ZNDKCDEV_CMDQ_NEED_WAKEUP);
+            t_idle = jiffies + cmdq->idle;
+        }
+        cond_resched();
     }
 
     return  0;
 }
 
 /**
- * zndkcdev_buf_rd()
- * @dcb
- * @mem
+ * zndkcdev_cmdq_setup()
+ * @brief    create the command queue of an open file, w/ a poller bound to
+ *           setup->sq_cpu (>= 0); one queue per file, freed at release()
+ * @note     the poller spins a whole CPU while busy: only on a CPU the caller may
+ *           run on itself (any w/ CAP_SYS_NICE), and for a bounded idle time
+ * @zf
+ * @setup    in: entries, sq_cpu, sq_idle_ms; out: entries (rounded up), len
  */
 static int
-zndkcdev_buf_rd(TZndkCdevDCB *dcb, TZndkCdevMem *mem)
+zndkcdev_cmdq_setup(TZndkCdevFile *zf, TZndkCdevCmdqSetup *setup)
 {
-    int     stat = 0;
-    int     ofs;
-    int     len;
-    int     remain;
-
-    if (mem->ofs < dcb->len_buf) {
-        /* correct params */
-        ofs      =  mem->ofs;
-        remain   =  dcb->len_buf - ofs - 1;
-        len      = (mem->len < remain) ? mem->len : remain;
+    TZndkCdevDCB     *dcb    = zf->dcb;
+    TZndkCdevCmdq    *cmdq;
+    TZndkCdevCmdqHdr *hdr;
+    struct task_struct *task;
+    unsigned long     sq_ofs = L1_CACHE_ALIGN(sizeof(TZndkCdevCmdqHdr));
+    unsigned long     cq_ofs;
+    int               stat   = 0;
+
+    if ((setup->sq_entries <= 0) || (setup->sq_entries > ZNDKCDEV_CMDQ_MAX_ENTRIES) ||
+        (setup->cq_entries <  0) || (setup->cq_entries > 2 * ZNDKCDEV_CMDQ_MAX_ENTRIES) ||
+        (setup->sq_idle_ms <  0) || (setup->sq_idle_ms > ZNDKCDEV_CMDQ_MAX_IDLE_MS) ||
+        ((setup->sq_cpu >= 0) && ((setup->sq_cpu >= nr_cpu_ids) || !cpu_online(setup->sq_cpu)))) {
+        return  -EINVAL;
+    }
+    if ((setup->sq_cpu >= 0) && !cpumask_test_cpu(setup->sq_cpu, current->cpus_ptr) &&
+        !capable(CAP_SYS_NICE)) {
+        return  -EPERM;
+    }
+    setup->sq_entries = roundup_pow_of_two(setup->sq_entries);
+    setup->cq_entries = (setup->cq_entries != 0) ? roundup_pow_of_two(setup->cq_entries)
+                                                 : 2 * setup->sq_entries;
+    if (setup->cq_entries < setup->sq_entries) {
+        return  -EINVAL;
+    }
 
-        if (copy_to_user((char *)mem->buf, (char *)(dcb->buf + ofs), len)) {
-            return  -1;
+    cmdq = kzalloc(sizeof(TZndkCdevCmdq), GFP_KERNEL);
+    if (cmdq == NULL) {
+        return  -ENOMEM;
+    }
+    cq_ofs    = sq_ofs + L1_CACHE_ALIGN(setup->sq_entries * sizeof(TZndkCdevSqe));
+    cmdq->len = PAGE_ALIGN(cq_ofs + setup->cq_entries * sizeof(TZndkCdevCqe));
+    hdr       = vmalloc_user(cmdq->len); /* zeroed, VM_USERMAP for remap_vmalloc_range() */
+    if (hdr == NULL) {
+        kfree(cmdq);
+        return  -ENOMEM;
+    }
+    hdr->sq_mask  = setup->sq_entries - 1;
+    hdr->cq_mask  = setup->cq_entries - 1;
+    hdr->sq_ofs   = sq_ofs;
+    hdr->cq_ofs   = cq_ofs;
+
+    cmdq->dcb     = dcb;
+    cmdq->hdr     = hdr;
+    cmdq->sqes    = (TZndkCdevSqe *)((char *)hdr + sq_ofs);
+    cmdq->cqes    = (TZndkCdevCqe *)((char *)hdr + cq_ofs);
+    cmdq->sq_mask = hdr->sq_mask;
+    cmdq->cq_mask = hdr->cq_mask;
+    cmdq->idle    = msecs_to_jiffies((setup->sq_idle_ms != 0) ? setup->sq_idle_ms : 1000);
+    cmdq->mm      = current->mm;
+    mmgrab(cmdq->mm);           /* mm_count only: don't keep the address space alive */
+    cmdq->pid_ns  = get_pid_ns(task_active_pid_ns(current));
+    mutex_init(&cmdq->mtx);
+
+    mutex_lock(&dcb->mtx);
+    if (zf->cmdq != NULL) {
+        stat = -EBUSY;
+        goto  setup_unlock;
+    }
+    if (setup->sq_cpu >= 0) {
+        task = kthread_create(zndkcdev_cmdq_poller, cmdq, NAME_MODULE "_sq/%d", dcb->minor);
+        if (IS_ERR(task)) {
+            stat = PTR_ERR(task);
+            goto  setup_unlock;
         }
-    } else {
-        pr_err(" %s[%2d]: %s():L%d: out of range: ofs must be less than %d (your: %d))\n",
-               NAME_MODULE, dcb->minor, __func__, __LINE__, dcb->len_buf, mem->ofs);
-        return  -2;
+        kthread_bind(task, setup->sq_cpu);
+        cmdq->poller = task;
+        wake_up_process(task);
     }
+    smp_store_release(&zf->cmdq, cmdq); /* ENTER/mmap look it up w/o dcb->mtx */
 
-    return  stat;
+setup_unlock:
+    mutex_unlock(&dcb->mtx);
+    if (stat < 0) {
+        _zndkcdev_cmdq_free(cmdq);
+        return  stat;
+    }
+    setup->len = cmdq->len;
+
+    return  0;
 }
 
 /**
- * zndkcdev_buf_wr()
- * @dcb
- * @mem
+ * zndkcdev_cmdq_enter()
+ * @brief    doorbell, once per batch: wake the poller up, or run the SQ in the
+ *           caller's context
+ * @return   # of commands run (0 w/ a poller), or -errno
  */
 static int
-zndkcdev_buf_wr(TZndkCdevDCB *dcb, TZndkCdevMem *mem)
+zndkcdev_cmdq_enter(TZndkCdevFile *zf)
 {
-    int     stat = 0;
-    int     ofs;
-    int     len;
-    u32     remain;
+    TZndkCdevCmdq *cmdq = smp_load_acquire(&zf->cmdq);
+    int            n;
 
-    if (mem->ofs < dcb->len_buf) {
-        /* correct params */
-        ofs      =  mem->ofs;
-        remain   =  dcb->len_buf - ofs - 1;
-        len      = (mem->len < remain) ? mem->len : remain;
+    if (cmdq == NULL) {
+        return  -EINVAL;
+    }
+    if (cmdq->poller != NULL) {
+        wake_up_process(cmdq->poller);
+        return  0;
+    }
+    if (current->mm != cmdq->mm) {
+        return  -EPERM;         /* addr of BUF_RD/WR belongs to the creator's address space */
+    }
 
-        if (copy_from_user((char *)(dcb->buf + ofs), (char *)mem->buf, len)) {
-            return  -1;
-        }
-    } else {
-        pr_err(" %s[%2d]: %s(): out of range: ofs must be less than %d (your: %d))\n",
-               NAME_MODULE, dcb->minor, __func__, dcb->len_buf, mem->ofs);
-        return  -2;
+    if (mutex_lock_interruptible(&cmdq->mtx)) {
+        return  -ERESTARTSYS;
     }
+    n = _zndkcdev_cmdq_run(cmdq);
+    mutex_unlock(&cmdq->mtx);
 
-    return  stat;
+    return  n;
 }
 
 /**
@@ -394,9 +2941,20 @@ zndkcdev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
     int            stat  =  0;
     TZndkCdevInfo *info  = _get_zndkcdev_info();
-    TZndkCdevDCB  *dcb   = (TZndkCdevDCB *)filp->private_data;
+    TZndkCdevDCB  *dcb   = _get_zndkcdev_filp_dcb(filp);
     TZndkCdevMem   mem;
+    TZndkCdevMemVec vec;
+    TZndkCdevFeature feat;
+    struct iov_iter iter;
+    TZndkCdevStats *stats;
     TSigMsg        sigmsg;
+    TZndkCdevCsum  csum;
+    TZndkCdevXfer  xf;
+    TZndkCdevCmdqSetup setup;
+    TZndkCdevGen   gen_ctl;
+    u64            gen;
+    ktime_t        t0;
+    int            op;
 
     switch(cmd) {
     case ZNDKCDEV_GET_VERSION:
@@ -407,18 +2965,161 @@ zndkcdev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         }
         break;
     case ZNDKCDEV_BUF_RD     :
-        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_RD\n"     , NAME_MODULE, dcb->minor, __func__);
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_RD\n"     , NAME_MODULE, dcb->minor, __func__);
         if (copy_from_user((void *)&mem, (const void __user *)arg, sizeof(TZndkCdevMem))) {
             return -EFAULT;
         }
-        zndkcdev_buf_rd(dcb, &mem);
+        stat = _zndkcdev_buf_errno(zndkcdev_buf_rd(dcb, &mem)); /* as uring_cmd/cmdq */
         break;
     case ZNDKCDEV_BUF_WR     :
-        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_WR\n"     , NAME_MODULE, dcb->minor, __func__);
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_WR\n"     , NAME_MODULE, dcb->minor, __func__);
         if (copy_from_user((void *)&mem, (const void __user *)arg, sizeof(TZndkCdevMem))) {
             return -EFAULT;
         }
-        zndkcdev_buf_wr(dcb, &mem);
+        stat = _zndkcdev_buf_errno(zndkcdev_buf_wr(dcb, &mem));
+        break;
+    case ZNDKCDEV_BUF_RDV    :
+    case ZNDKCDEV_BUF_WRV    :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_%sV\n"  , NAME_MODULE, dcb->minor, __func__,
+                 (cmd == ZNDKCDEV_BUF_WRV) ? "WR" : "RD");
+        if (copy_from_user((void *)&vec, (const void __user *)arg, sizeof(TZndkCdevMemVec))) {
+            return -EFAULT;
+        }
+        stat = zndkcdev_buf_rwv(dcb, &vec, (cmd == ZNDKCDEV_BUF_WRV));
+        break;
+    case ZNDKCDEV_SET_MMAP   :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_SET_MMAP\n"   , NAME_MODULE, dcb->minor, __func__);
+        if ((arg != ZNDKCDEV_MMAP_WB) && (arg != ZNDKCDEV_MMAP_WC) && (arg != ZNDKCDEV_MMAP_UC)) {
+            return -EINVAL;
+        }
+#ifndef CONFIG_X86
+        if (arg != ZNDKCDEV_MMAP_WB) {
+            return -EOPNOTSUPP; /* no BUF_SYNC to flush the write-back alias with */
+        }
+#endif
+        _get_zndkcdev_file(filp)->mmap_mode = (int)arg; /* applies to later mmap() on this fd */
+        break;
+    case ZNDKCDEV_BUF_SYNC   :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_SYNC\n"  , NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&mem, (const void __user *)arg, sizeof(TZndkCdevMem))) {
+            return -EFAULT;
+        }
+        stat = zndkcdev_buf_sync(dcb, &mem);
+        break;
+    case ZNDKCDEV_GET_BUF_LEN:
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_GET_BUF_LEN\n", NAME_MODULE, dcb->minor, __func__);
+        if (copy_to_user((int __user *)arg, &dcb->len_buf, sizeof(int))) {
+            return -EFAULT;
+        }
+        break;
+    case ZNDKCDEV_GET_FEATURE:
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_GET_FEATURE\n", NAME_MODULE, dcb->minor, __func__);
+        zndkcdev_get_feature(dcb, &feat);
+        if (copy_to_user((void __user *)arg, &feat, sizeof(TZndkCdevFeature))) {
+            return -EFAULT;
+        }
+        break;
+    case ZNDKCDEV_BUF_RESIZE :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_RESIZE\n" , NAME_MODULE, dcb->minor, __func__);
+        stat = zndkcdev_buf_resize(dcb, arg);
+        break;
+    case ZNDKCDEV_SHARD_DRAIN:
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_SHARD_DRAIN\n", NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&mem, (const void __user *)arg, sizeof(TZndkCdevMem))) {
+            return -EFAULT;
+        }
+        if (dcb->mode != ZNDKCDEV_MODE_SHARD) {
+            return -EINVAL;
+        }
+        stat = import_ubuf(ITER_DEST, mem.buf, mem.len, &iter);
+        if (stat < 0) {
+            return  stat;
+        }
+        stat = zndkcdev_shard_drain(dcb, &iter, mem.ofs, (filp->f_flags & O_NONBLOCK)); /* ofs: shard # (< 0: all) */
+        break;
+    case ZNDKCDEV_GET_STATS  :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_GET_STATS\n" , NAME_MODULE, dcb->minor, __func__);
+        stats = kmalloc(sizeof(TZndkCdevStats), GFP_KERNEL); /* too large for the stack */
+        if (stats == NULL) {
+            return -ENOMEM;
+        }
+        zndkcdev_get_stats(dcb, stats);
+        if (copy_to_user((void __user *)arg, stats, sizeof(TZndkCdevStats))) {
+            stat = -EFAULT;
+        }
+        kfree(stats);
+        break;
+    case ZNDKCDEV_EXPORT_DMABUF:
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_EXPORT_DMABUF\n", NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&mem, (const void __user *)arg, sizeof(TZndkCdevMem))) {
+            return -EFAULT;
+        }
+        stat = zndkcdev_export_dmabuf(dcb, &mem);
+        break;
+    case ZNDKCDEV_BUF_CSUM   :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_CSUM\n" , NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&csum, (const void __user *)arg, sizeof(TZndkCdevCsum))) {
+            return -EFAULT;
+        }
+        stat = zndkcdev_buf_csum(dcb, &csum);
+        if ((stat == 0) && copy_to_user((void __user *)arg, &csum, sizeof(TZndkCdevCsum))) {
+            stat = -EFAULT;
+        }
+        break;
+    case ZNDKCDEV_BUF_FILL   :
+    case ZNDKCDEV_BUF_MOVE   :
+    case ZNDKCDEV_BUF_COPY   :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_BUF_FILL/MOVE/COPY\n", NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&xf, (const void __user *)arg, sizeof(TZndkCdevXfer))) {
+            return -EFAULT;
+        }
+        t0   = ktime_get();
+        if (cmd == ZNDKCDEV_BUF_FILL) {
+            stat = zndkcdev_buf_fill(dcb, &xf);
+            op   = ZNDKCDEV_STAT_FILL;
+        } else if (cmd == ZNDKCDEV_BUF_MOVE) {
+            stat = zndkcdev_buf_move(dcb, &xf);
+            op   = ZNDKCDEV_STAT_MOVE;
+        } else {
+            stat = zndkcdev_buf_copy(dcb, &xf);
+            op   = ZNDKCDEV_STAT_COPY;
+        }
+        _zndkcdev_stat(dcb, op, stat, (stat == 0) ? xf.len : 0, t0);
+        break;
+    case ZNDKCDEV_CMDQ_SETUP :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_CMDQ_SETUP\n" , NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&setup, (const void __user *)arg, sizeof(TZndkCdevCmdqSetup))) {
+            return -EFAULT;
+        }
+        stat = zndkcdev_cmdq_setup(_get_zndkcdev_file(filp), &setup);
+        if ((stat == 0) && copy_to_user((void __user *)arg, &setup, sizeof(TZndkCdevCmdqSetup))) {
+            stat = -EFAULT;
+        }
+        break;
+    case ZNDKCDEV_CMDQ_ENTER :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_CMDQ_ENTER\n", NAME_MODULE, dcb->minor, __func__);
+        stat = zndkcdev_cmdq_enter(_get_zndkcdev_file(filp));
+        break;
+    case ZNDKCDEV_GEN_START  :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_GEN_START\n"  , NAME_MODULE, dcb->minor, __func__);
+        if (copy_from_user((void *)&gen_ctl, (const void __user *)arg, sizeof(TZndkCdevGen))) {
+            return -EFAULT;
+        }
+        stat = zndkcdev_gen_start(dcb, &gen_ctl);
+        break;
+    case ZNDKCDEV_GEN_STOP   :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_GEN_STOP\n"   , NAME_MODULE, dcb->minor, __func__);
+        stat = zndkcdev_gen_stop(dcb, &gen_ctl);
+        if ((stat == 0) && arg && copy_to_user((void __user *)arg, &gen_ctl, sizeof(TZndkCdevGen))) {
+            stat = -EFAULT;
+        }
+        break;
+    case ZNDKCDEV_FLIP       :
+        pr_debug(" %s[%2d]: %s: ioctl: ZNDKCDEV_FLIP\n"     , NAME_MODULE, dcb->minor, __func__);
+        stat = zndkcdev_flip(dcb, &gen);
+        if ((stat == 0) && arg && copy_to_user((u64 __user *)arg, &gen, sizeof(u64))) {
+            stat = -EFAULT;
+        }
         break;
     case ZNDKCDEV_PRINTK     :
         pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_PRINTK\n"     , NAME_MODULE, dcb->minor, __func__);
@@ -429,7 +3130,19 @@ zndkcdev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (copy_from_user((void *)&sigmsg, (const void __user *)arg, sizeof(TSigMsg))) {
             return -EFAULT;
         }
-        zndkcdev_send_signal(dcb, &sigmsg);
+        t0   = ktime_get();
+        stat = zndkcdev_send_signal(dcb, &sigmsg, task_active_pid_ns(current));
+        _zndkcdev_stat(dcb, ZNDKCDEV_STAT_SIGNAL, stat, 0, t0);
+        break;
+    case ZNDKCDEV_SET_MODE   :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_SET_MODE\n"   , NAME_MODULE, dcb->minor, __func__);
+        stat = zndkcdev_set_mode(dcb, (int)arg);
+        break;
+    case ZNDKCDEV_GET_MODE   :
+        pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_GET_MODE\n"   , NAME_MODULE, dcb->minor, __func__);
+        if (copy_to_user((int __user *)arg, &dcb->mode, sizeof(int))) {
+            return -EFAULT;
+        }
         break;
     case ZNDKCDEV_TEST       :
         pr_info(" %s[%2d]: %s: ioctl: ZNDKCDEV_TEST\n"       , NAME_MODULE, dcb->minor, __func__);
@@ -442,97 +3155,318 @@ zndkcdev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     return  stat;
 }
 
+/**
+ * zndkcdev_uring_cmd()
+ * @brief    IORING_OP_URING_CMD: ZNDKCDEV_BUF_(RD|WR) w/ the TZndkCdevMem in sqe->cmd
+ * @ioucmd
+ * @issue_flags
+ * @note     the byte-range lock may sleep: the inline (IO_URING_F_NONBLOCK) issue
+ *           is handed back w/ -EAGAIN and io_uring reissues it from io-wq
+ */
+static int
+zndkcdev_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+    TZndkCdevDCB  *dcb  = _get_zndkcdev_filp_dcb(ioucmd->file);
+    TZndkCdevMem   mem;
+    int            stat;
+
+    if ((ioucmd->cmd_op != ZNDKCDEV_BUF_RD) && (ioucmd->cmd_op != ZNDKCDEV_BUF_WR)) {
+        return  -ENOTTY;
+    }
+    if (issue_flags & IO_URING_F_NONBLOCK) {
+        return  -EAGAIN;
+    }
+
+    /* the SQE is shared w/ user space: take one snapshot */
+    memcpy(&mem, io_uring_sqe_cmd(ioucmd->sqe), sizeof(TZndkCdevMem));
+
+    if (ioucmd->cmd_op == ZNDKCDEV_BUF_RD) {
+        stat = zndkcdev_buf_rd(dcb, &mem);
+    } else {
+        stat = zndkcdev_buf_wr(dcb, &mem);
+    }
+
+    return  _zndkcdev_buf_errno(stat);
+}
+
 /**
  * zndkcdev_fops
  */
 static const struct file_operations zndkcdev_fops = {
+    .owner          = THIS_MODULE   ,
     .open           = zndkcdev_open ,
     .release        = zndkcdev_close,
-    .read           = zndkcdev_read ,
-    .write          = zndkcdev_write,
+    .llseek         = zndkcdev_llseek,
+    .read_iter      = zndkcdev_read_iter ,
+    .write_iter     = zndkcdev_write_iter,
+    .splice_read    = zndkcdev_splice_read,
+    .splice_write   = iter_file_splice_write, /* pipe pages -> write_iter, one copy */
+    .poll           = zndkcdev_poll ,
     .mmap           = zndkcdev_mmap ,
+    .get_unmapped_area = thp_get_unmapped_area, /* 2 MiB aligned user VA for PMD mappings */
     .unlocked_ioctl = zndkcdev_ioctl,
+    .uring_cmd      = zndkcdev_uring_cmd,
+};
+
+/**
+ * stats_show()
+ * @brief    /sys/class/zndkcdev/zndkcdev_<n>/stats:
+ *           "<op> ops=<n> bytes=<n> errs=<n> hist=<log2 ns>:<count> ..."
+ */
+static ssize_t
+stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    static const char *name[ZNDKCDEV_N_STAT] = { "read", "write", "buf_rd", "buf_wr", "mmap", "signal", "fill", "move", "copy" };
+    TZndkCdevDCB   *dcb   = dev_get_drvdata(dev);
+    TZndkCdevStats *stats;
+    int             len   = 0;
+    int             op;
+    int             bkt;
+
+    stats = kmalloc(sizeof(TZndkCdevStats), GFP_KERNEL);
+    if (stats == NULL) {
+        return  -ENOMEM;
+    }
+    zndkcdev_get_stats(dcb, stats);
+
+    for (op = 0; op < ZNDKCDEV_N_STAT; op++) {
+        len += sysfs_emit_at(buf, len, "%-6s ops=%llu bytes=%llu errs=%llu hist=", name[op],
+                             stats->op[op].n_op, stats->op[op].n_byte, stats->op[op].n_err);
+        for (bkt = 0; bkt < ZNDKCDEV_N_HIST; bkt++) {
+            if (stats->op[op].hist[bkt] != 0) {
+                len += sysfs_emit_at(buf, len, " %d:%llu", bkt, stats->op[op].hist[bkt]);
+            }
+        }
+        len += sysfs_emit_at(buf, len, "\n");
+    }
+    kfree(stats);
+
+    return  len;
+}
+static DEVICE_ATTR_RO(stats);
+
+/**
+ * gen_show()
+ * @brief    /sys/class/zndkcdev/zndkcdev_<n>/gen: synthetic producer state, live
+ *           "running=<0|1> len_rec=<B> period_us=<n> rate=<B/s> n_rec=<n> n_drop=<n>"
+ */
+static ssize_t
+gen_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    TZndkCdevDCB   *dcb   = dev_get_drvdata(dev);
+
+    return  sysfs_emit(buf, "running=%d len_rec=%d period_us=%d rate=%llu n_rec=%llu n_drop=%llu\n",
+                       READ_ONCE(dcb->gen_task) != NULL, dcb->gen.len_rec, dcb->gen.period_us,
+                       dcb->gen.rate, READ_ONCE(dcb->gen.n_rec), READ_ONCE(dcb->gen.n_drop));
+}
+static DEVICE_ATTR_RO(gen);
+
+static struct attribute *zndkcdev_attrs[] = {
+    &dev_attr_stats.attr,
+    &dev_attr_gen.attr,
+    NULL,
 };
+ATTRIBUTE_GROUPS(zndkcdev);
 
 /**
  * zndkcdev_probe()
+ * @brief    create a device /dev/zndkcdev_<minor> (call w/ info->mtx held)
  * @info
- * @idx_minor
+ * @idx_minor  minor # to create (< 0: lowest free one)
+ * @len_buf    buffer size [B] (0: len_buf module parameter)
+ * @return     minor # created, or -errno
  */
 static int
-zndkcdev_probe(TZndkCdevInfo *info, int idx_minor)
+zndkcdev_probe(TZndkCdevInfo *info, int idx_minor, int len_buf)
 {
     int             stat;
-    TZndkCdevDCB   *dcb     = _get_zndkcdev_dcb(idx_minor);
+    TZndkCdevDCB   *dcb;
     dev_t           dev_num;
     struct device  *dev;
-    struct cdev    *c_dev;
     char           *buf;
+    unsigned long   len;
+    int             idx;
 
-    _init_zndkcdev_dcb(dcb);
-
-    /* create a device file: /dev/zndkcdev_<n> */
-    dev_num        = MKDEV(MAJOR(info->dev_num), idx_minor);
-    dev            = device_create(info->cl, NULL, dev_num, NULL, NAME_MODULE "_%d", idx_minor);
-    if (dev == NULL) {
-        pr_err(" %s[%2d]: %s():L%d: could not create a device\n", NAME_MODULE, dcb->minor, __func__, __LINE__);
-        return -1;
+    if ((idx_minor >= ZNDKCDEV_MAX_DEV) || (len_buf < 0) || (len_buf > ZNDKCDEV_MAX_BUF)) {
+        return  -EINVAL;
     }
-    dcb->dev       = dev;
-    dcb->dev_num   = dev_num;
 
-    /* add a character device */
-    c_dev           = &dcb->c_dev;
-    cdev_init(c_dev, &zndkcdev_fops);
-    stat = cdev_add(c_dev, dev_num, 1);
+    dcb = kzalloc(sizeof(TZndkCdevDCB), GFP_KERNEL);
+    if (dcb == NULL) {
+        return  -ENOMEM;
+    }
+    stat = _init_zndkcdev_dcb(dcb);
     if (stat < 0) {
-        pr_err(" %s[%2d]: %s():L%d: could not add a chrdev\n", NAME_MODULE, dcb->minor, __func__, __LINE__);
-        return -2;
+        goto  probe_free_dcb;
     }
 
-    /* prepare test buffer */
-    buf = kzalloc(dcb->len_buf, GFP_KERNEL);
+    /* prepare test buffer: before the minor gets visible to open() */
+    len = (len_buf != 0) ? len_buf : dcb->len_buf;
+    len = (len < PAGE_SIZE) ? PAGE_SIZE : len;
+    buf = _zndkcdev_buf_alloc(&len, &dcb->hpages);
     if (buf == NULL) {
-        pr_err(" %s[%2d]: %s():L%d: could not allocate memory buffer\n", NAME_MODULE, dcb->minor, __func__, __LINE__);
-        return -3;
+        pr_err(" %s[--]: %s():L%d: could not allocate memory buffer\n", NAME_MODULE, __func__, __LINE__);
+        stat = -ENOMEM;
+        goto  probe_free_dcb;
     }
     dcb->buf       = buf;
+    dcb->len_buf   = len;
+    _zndkcdev_ring_init(&dcb->fifo, dcb->buf, dcb->len_buf);
+
+    /* SHARD mode: one slice per CPU, set up once so writers never see it go away */
+    dcb->n_shard   = min_t(int, nr_cpu_ids, ZNDKCDEV_MAX_SHARD);
+    dcb->shard     = kcalloc(dcb->n_shard, sizeof(TZndkCdevShard), GFP_KERNEL);
+    if (dcb->shard == NULL) {
+        stat = -ENOMEM;
+        goto  probe_free_buf;
+    }
+    for (idx = 0; idx < dcb->n_shard; idx++) {
+        mutex_init(&dcb->shard[idx].mtx);
+    }
+    _zndkcdev_shard_reset(dcb);
+
+    /* reserve the minor # */
+    if (idx_minor < 0) {
+        stat = idr_alloc(&info->idr, dcb, 0        , ZNDKCDEV_MAX_DEV, GFP_KERNEL);
+    } else {
+        stat = idr_alloc(&info->idr, dcb, idx_minor, idx_minor + 1   , GFP_KERNEL);
+    }
+    if (stat < 0) {
+        pr_err(" %s[--]: %s():L%d: minor %d is not available (%d)\n", NAME_MODULE, __func__, __LINE__, idx_minor, stat);
+        stat = (stat == -ENOSPC) ? -EEXIST : stat;
+        goto  probe_free_buf;
+    }
+    idx_minor      = stat;
     dcb->minor     = idx_minor;
 
+    /* create a device file: /dev/zndkcdev_<n> */
+    dev_num        = MKDEV(info->major, idx_minor);
+    dev            = device_create_with_groups(info->cl, NULL, dev_num, dcb, zndkcdev_groups,
+                                               NAME_MODULE "_%d", idx_minor);
+    if (IS_ERR_OR_NULL(dev)) {
+        pr_err(" %s[%2d]: %s():L%d: could not create a device\n", NAME_MODULE, dcb->minor, __func__, __LINE__);
+        stat = (dev == NULL) ? -ENODEV : PTR_ERR(dev);
+        goto  probe_free_minor;
+    }
+    dcb->dev       = dev;
+    dcb->dev_num   = dev_num;
+
     dcb->init_done = 1;
+    info->n_dev++;
+
+    return  idx_minor;
+
+probe_free_minor:
+    idr_remove(&info->idr, idx_minor);
+probe_free_buf:
+    kfree(dcb->shard);
+    _zndkcdev_buf_free(dcb->buf, dcb->len_buf, dcb->hpages);
+probe_free_dcb:
+    _cleanup_zndkcdev_dcb(dcb);
+    kfree(dcb);
 
     return  stat;
 }
 
 /**
  * zndkcdev_remove()
+ * @brief    destroy a device /dev/zndkcdev_<minor> (call w/ info->mtx held)
  * @info
  * @idx_minor
+ * @force      0: refuse (-EBUSY) while opened or mapped, 1: module exit
  */
 static int
-zndkcdev_remove(TZndkCdevInfo *info, int idx_minor)
+zndkcdev_remove(TZndkCdevInfo *info, int idx_minor, int force)
 {
     int             stat =  0;
     TZndkCdevDCB   *dcb  = _get_zndkcdev_dcb(idx_minor);
 
-    if (dcb->buf       != NULL) {
-        pr_debug(" %s[%2d]: %s(): kfree()\n"         , NAME_MODULE, dcb->minor, __func__);
-        kfree(dcb->buf);
+    if (dcb == NULL) {
+        return  -ENODEV;
     }
-    if (dcb->init_done == 1   ) {
-        pr_debug(" %s[%2d]: %s(): cdev_del()\n"      , NAME_MODULE, dcb->minor, __func__);
-        cdev_del(&dcb->c_dev);
+    if (!force && ((atomic_read(&dcb->n_open) > 0) || (atomic_read(&dcb->n_mmap) > 0))) {
+        return  -EBUSY;
+    }
+
+    idr_remove(&info->idr, idx_minor); /* open() can't find it any more */
+
+    if (dcb->gen_task  != NULL) {
+        kthread_stop(dcb->gen_task); /* before the buffer goes */
+        dcb->gen_task = NULL;
     }
+
     if (dcb->dev       != NULL) {
         pr_debug(" %s[%2d]: %s(): device_destroy()\n", NAME_MODULE, dcb->minor, __func__);
         device_destroy(info->cl, dcb->dev_num);
     }
+    if (dcb->buf       != NULL) {
+        pr_debug(" %s[%2d]: %s(): free buffer\n"     , NAME_MODULE, dcb->minor, __func__);
+        _zndkcdev_buf_free(dcb->buf, dcb->len_buf, dcb->hpages);
+    }
 
+    kfree(dcb->shard);
     _cleanup_zndkcdev_dcb(dcb);
+    kfree(dcb);
+    info->n_dev--;
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_ctl_ioctl()
+ * @brief    /dev/zndkcdev_ctl: create/destroy devices on demand
+ */
+static long
+zndkcdev_ctl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    int              stat  =  0;
+    TZndkCdevInfo   *info  = _get_zndkcdev_info();
+    TZndkCdevCreate  crt;
+
+    switch(cmd) {
+    case ZNDKCDEV_CTL_CREATE :
+        if (copy_from_user((void *)&crt, (const void __user *)arg, sizeof(TZndkCdevCreate))) {
+            return -EFAULT;
+        }
+        mutex_lock(&info->mtx);
+        stat = zndkcdev_probe(info, crt.minor, crt.len_buf);
+        if (stat >= 0) {
+            crt.minor   = stat;
+            crt.len_buf = _get_zndkcdev_dcb(stat)->len_buf;
+        }
+        mutex_unlock(&info->mtx);
+        pr_info(" %s[--]: %s: ioctl: ZNDKCDEV_CTL_CREATE: minor=%d (%d)\n", NAME_MODULE, __func__, crt.minor, stat);
+        if (stat < 0) {
+            return  stat;
+        }
+        if (copy_to_user((void __user *)arg, &crt, sizeof(TZndkCdevCreate))) {
+            return -EFAULT;
+        }
+        stat = 0;
+        break;
+    case ZNDKCDEV_CTL_DESTROY:
+        mutex_lock(&info->mtx);
+        stat = zndkcdev_remove(info, (int)arg, 0);
+        mutex_unlock(&info->mtx);
+        pr_info(" %s[--]: %s: ioctl: ZNDKCDEV_CTL_DESTROY: minor=%d (%d)\n", NAME_MODULE, __func__, (int)arg, stat);
+        break;
+    default:
+        pr_info(" %s[--]: %s: ioctl: unknown cmand\n", NAME_MODULE, __func__);
+        stat = -ENOTTY;
+        break;
+    }
 
     return  stat;
 }
 
+/**
+ * zndkcdev_ctl_fops
+ */
+static const struct file_operations zndkcdev_ctl_fops = {
+    .owner          = THIS_MODULE       ,
+    .unlocked_ioctl = zndkcdev_ctl_ioctl,
+};
+
 /**
  * _zndkcdev_cleanup()
  */
@@ -541,22 +3475,33 @@ _zndkcdev_cleanup(void)
 {
     int             stat =  0;
     TZndkCdevInfo  *info = _get_zndkcdev_info();
+    TZndkCdevDCB   *dcb;
     int             idx_minor;
 
     pr_info(" %s[--]: %s(): ----- start -----\n", NAME_MODULE, __func__);
 
     /* destroy device files */
-    for (idx_minor = 0; idx_minor < info->n_dev; idx_minor++) {
-        zndkcdev_remove(info, idx_minor);
+    mutex_lock(&info->mtx);
+    idr_for_each_entry(&info->idr, dcb, idx_minor) {
+        zndkcdev_remove(info, idx_minor, 1);
+    }
+    mutex_unlock(&info->mtx);
+
+    if (info->dev_ctl   != NULL) {
+        pr_debug(" %s[--]: %s(): device_destroy(ctl)\n", NAME_MODULE, __func__);
+        device_destroy(info->cl, MKDEV(info->major, ZNDKCDEV_CTL_MINOR));
+    }
+    if (info->init_done == 1   ) {
+        pr_debug(" %s[--]: %s(): cdev_del()\n", NAME_MODULE, __func__);
+        cdev_del(&info->c_dev);
     }
-    
     if (info->cl        != NULL) {
         pr_debug(" %s[--]: %s(): class_destroy()\n", NAME_MODULE, __func__);
         class_destroy(info->cl);
     }
     if (info->dev_num   != 0   ) {
         pr_debug(" %s[--]: %s(): unregister_chrdev_region()\n", NAME_MODULE, __func__);
-        unregister_chrdev_region(info->dev_num, info->n_dev);
+        unregister_chrdev_region(info->dev_num, ZNDKCDEV_N_MINOR);
     }
 
     _cleanup_zndkcdev_info(info);
@@ -576,15 +3521,19 @@ zndkcdev_init(void)
     TZndkCdevInfo  *info    = _get_zndkcdev_info();
     dev_t           dev_num;
     struct class   *cl;
+    struct device  *dev;
     int             idx_minor;
 
     pr_info(" %s[--]: %s(): ##### INIT  #####\n", NAME_MODULE, __func__);
 
-    _init_zndkcdev_info(info);
-    pr_info(" %s[--]: %s(): %s\n", NAME_MODULE, __func__, info->ver);
+    stat = _init_zndkcdev_info(info);
+    if (stat < 0) {
+        return  stat;
+    }
+    pr_info(" %s[--]: %s(): %s, n_dev=%d, len_buf=%d\n", NAME_MODULE, __func__, info->ver, zndkcdev_n_dev, zndkcdev_len_buf);
 
-    /* register a character deivce */
-    stat = alloc_chrdev_region(&dev_num, 0, 1, NAME_MODULE);
+    /* register a character deivce: reserve every minor up front, devices come and go */
+    stat = alloc_chrdev_region(&dev_num, 0, ZNDKCDEV_N_MINOR, NAME_MODULE);
     if (stat < 0) {
         pr_err(" %s[--]: %s():L%d: could not register a chrdev\n", NAME_MODULE, __func__, __LINE__);
         goto  err_init;
@@ -593,16 +3542,38 @@ zndkcdev_init(void)
     info->major     = MAJOR(dev_num);
 
     /* create a class: /sys/class */
-    cl   = class_create(THIS_MODULE, NAME_MODULE);
-    if (cl == NULL) {
+    cl   = class_create(NAME_MODULE);
+    if (IS_ERR(cl)) {
         pr_err(" %s[--]: %s():L%d: could not create a class\n", NAME_MODULE, __func__, __LINE__);
+        stat = PTR_ERR(cl);
         goto  err_init;
     }
     info->cl        = cl;
 
-    /* create device files */
-    for (idx_minor = 0; idx_minor < info->n_dev; idx_minor++) {
-        stat = zndkcdev_probe(info, idx_minor);
+    /* add one character device covering the whole minor range */
+    cdev_init(&info->c_dev, &zndkcdev_fops);
+    info->c_dev.owner = THIS_MODULE;
+    stat = cdev_add(&info->c_dev, dev_num, ZNDKCDEV_N_MINOR);
+    if (stat < 0) {
+        pr_err(" %s[--]: %s():L%d: could not add a chrdev\n", NAME_MODULE, __func__, __LINE__);
+        goto  err_init;
+    }
+    info->init_done = 1;
+
+    /* create the control device: /dev/zndkcdev_ctl */
+    dev  = device_create(cl, NULL, MKDEV(info->major, ZNDKCDEV_CTL_MINOR), NULL, NAME_MODULE "_ctl");
+    if (IS_ERR_OR_NULL(dev)) {
+        pr_err(" %s[--]: %s():L%d: could not create the control device\n", NAME_MODULE, __func__, __LINE__);
+        stat = (dev == NULL) ? -ENOMEM : PTR_ERR(dev);
+        goto  err_init;
+    }
+    info->dev_ctl   = dev;
+
+    /* create the initial device files */
+    for (idx_minor = 0; idx_minor < zndkcdev_n_dev; idx_minor++) {
+        mutex_lock(&info->mtx);
+        stat = zndkcdev_probe(info, idx_minor, 0);
+        mutex_unlock(&info->mtx);
         if (stat < 0) {
             pr_err( " %s[--]: %s():L%d: could not create a device file(minor=%d)\n",
                     NAME_MODULE, __func__, __LINE__, idx_minor);
@@ -613,10 +3584,10 @@ zndkcdev_init(void)
     return  0;
 
  err_init:
-    pr_err(" %s(); error\n", __func__);
+    pr_err(" %s(); error (%d)\n", __func__, stat);
     _zndkcdev_cleanup();
 
-    return  0;
+    return  stat;               /* the module doesn't stay loaded half set up */
 }
 
 /**
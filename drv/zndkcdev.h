@@ -20,9 +20,26 @@
 #define  ZNDKCDEV_VERSION              "0.0.1" /* <major>.<minor>.<revision>   */
 #define  LEN_VER                       20      /* length of version string [B] */
 
-#define  N_ZNDKCDEV                     2
+#define  N_ZNDKCDEV                     2  /* default # of devices (n_dev=)         */
+#define  ZNDKCDEV_MAX_DEV            4096  /* minors 0..MAX_DEV-1: /dev/zndkcdev_<n> */
+#define  ZNDKCDEV_CTL_MINOR  ZNDKCDEV_MAX_DEV /* minor of /dev/zndkcdev_ctl         */
+#define  ZNDKCDEV_N_MINOR   (ZNDKCDEV_MAX_DEV + 1) /* # of minors reserved          */
 
-#define  LEN_ZNDKCDEV_BUF          (1024 * 1024 * 1) /* unit: [B] */
+#define  LEN_ZNDKCDEV_BUF          (1024 * 1024 * 1) /* unit: [B], default (len_buf=) */
+#define  ZNDKCDEV_MAX_BUF          (1024 * 1024 * 1024) /* unit: [B], upper limit     */
+
+/* device modes (ZNDKCDEV_SET_MODE) */
+#define  ZNDKCDEV_MODE_FLAT             0 /* flat buffer, overwrite by offset    */
+#define  ZNDKCDEV_MODE_FIFO             1 /* ring buffer, blocking pipe semantic */
+#define  ZNDKCDEV_MODE_SHARD            2 /* per-CPU rings, lock-free across CPUs */
+#define  ZNDKCDEV_MODE_FLIP             3 /* front/back frames, ZNDKCDEV_FLIP publishes */
+
+#define  ZNDKCDEV_MAX_SHARD            64 /* max # of shards (SHARD mode)        */
+
+/* mmap cache modes (ZNDKCDEV_SET_MMAP, per open) */
+#define  ZNDKCDEV_MMAP_WB               0 /* write-back (cached), default        */
+#define  ZNDKCDEV_MMAP_WC               1 /* write-combining                     */
+#define  ZNDKCDEV_MMAP_UC               2 /* uncached                            */
 
 /**
  * @struct  TZndkCdevMem
@@ -34,6 +51,232 @@ typedef struct {
     int      len;               /* R/W buffer lenght (unit: [B])      */
 } TZndkCdevMem;
 
+/**
+ * @struct  TZndkCdevMemVec
+ * @brief   batch of ZndkCdev Memory Buffer segments (ZNDKCDEV_BUF_(RD|WR)V)
+ */
+typedef struct {
+    TZndkCdevMem *mem;          /* array of segments                  */
+    int          *stat;         /* per-segment 0/-errno (NULL: ignore)*/
+    int           n_mem;        /* # of segments                      */
+} TZndkCdevMemVec;
+
+#define  ZNDKCDEV_MEMVEC_MAX         1024 /* max # of segments per batch      */
+#define  ZNDKCDEV_MEMVEC_CHUNK         32 /* segments fetched at once (drv)   */
+
+/**
+ * @struct  TZndkCdevFeature
+ * @brief   version and features of a device (ZNDKCDEV_GET_FEATURE)
+ */
+typedef struct {
+    char          ver[LEN_VER + 1]; /* driver version                     */
+    int           n_dev;        /* # of devices                       */
+    int           len_buf;      /* buffer size of this device [B]     */
+    int           flags;        /* ZNDKCDEV_FEAT_*                    */
+    unsigned long map_size;     /* mmap page granule [B]              */
+    int           n_fault_pmd;  /* # of PMD (2 MiB) mappings made     */
+    int           n_fault_pte;  /* # of PTE (4 KiB) fallbacks         */
+    int           n_shard;      /* # of shards in SHARD mode          */
+} TZndkCdevFeature;
+
+#define  ZNDKCDEV_FEAT_HUGE_PMD     0x0001 /* buffer is backed/mapped by 2 MiB pages */
+
+/* operations counted per device (ZNDKCDEV_GET_STATS, sysfs "stats") */
+#define  ZNDKCDEV_STAT_READ             0 /* read(2)/readv(2)/pread(2)    */
+#define  ZNDKCDEV_STAT_WRITE            1 /* write(2)/writev(2)/pwrite(2) */
+#define  ZNDKCDEV_STAT_BUF_RD           2 /* ZNDKCDEV_BUF_RD(V) segment   */
+#define  ZNDKCDEV_STAT_BUF_WR           3 /* ZNDKCDEV_BUF_WR(V) segment   */
+#define  ZNDKCDEV_STAT_MMAP             4 /* mmap(2)                      */
+#define  ZNDKCDEV_STAT_SIGNAL           5 /* ZNDKCDEV_SIGNAL              */
+#define  ZNDKCDEV_STAT_FILL             6 /* ZNDKCDEV_BUF_FILL (+ cmdq)   */
+#define  ZNDKCDEV_STAT_MOVE             7 /* ZNDKCDEV_BUF_MOVE            */
+#define  ZNDKCDEV_STAT_COPY             8 /* ZNDKCDEV_BUF_COPY            */
+#define  ZNDKCDEV_N_STAT                9
+
+#define  ZNDKCDEV_N_HIST               32 /* latency buckets: [2^n, 2^(n+1)) ns */
+
+/**
+ * @struct  TZndkCdevStatOp
+ * @brief   counters of one operation
+ */
+typedef struct {
+    unsigned long long n_op;    /* # of successful calls              */
+    unsigned long long n_byte;  /* # of bytes moved                   */
+    unsigned long long n_err;   /* # of failed calls                  */
+    unsigned long long hist[ZNDKCDEV_N_HIST]; /* log2 latency histogram [ns] */
+} TZndkCdevStatOp;
+
+/**
+ * @struct  TZndkCdevStats
+ * @brief   performance counters of a device (ZNDKCDEV_GET_STATS)
+ */
+typedef struct {
+    TZndkCdevStatOp op[ZNDKCDEV_N_STAT]; /* indexed by ZNDKCDEV_STAT_*   */
+} TZndkCdevStats;
+
+/**
+ * @struct  TZndkCdevFlipCtl
+ * @brief   FLIP mode control page, mmap'able read-only at ZNDKCDEV_FLIP_CTL_OFS
+ *
+ * @note    each frame takes half of the buffer; reads/BUF_RD see the front
+ *          frame, writes/BUF_WR fill the back frame (offsets are frame relative),
+ *          ZNDKCDEV_FLIP swaps them. mmap readers: gen = ctl->gen (acquire),
+ *          read the frame at (gen & 1) * len_frame, retry if ctl->gen != gen
+ */
+typedef struct {
+    unsigned long long gen;     /* # of flips: front frame = gen & 1  */
+    unsigned int  len_frame;    /* frame size [B] (page aligned)      */
+    unsigned int  ofs_front;    /* offset of the front frame in buf   */
+} TZndkCdevFlipCtl;
+
+#define  ZNDKCDEV_FLIP_CTL_OFS      ZNDKCDEV_MAX_BUF /* mmap offset of the control page */
+
+/* checksum algorithms (ZNDKCDEV_BUF_CSUM) */
+#define  ZNDKCDEV_CSUM_CRC32C           0 /* CRC-32C (Castagnoli), init/xorout ~0   */
+#define  ZNDKCDEV_CSUM_XXH64            1 /* xxHash64                               */
+
+/**
+ * @struct  TZndkCdevCsum
+ * @brief   checksum of a buffer range computed in the kernel (ZNDKCDEV_BUF_CSUM)
+ */
+typedef struct {
+    int           ofs;          /* in : offset of the range (as BUF_RD)      */
+    int           len;          /* in : length of the range [B]              */
+    int           algo;         /* in : ZNDKCDEV_CSUM_*                      */
+    int           rsvd;
+    unsigned long long seed;    /* in : CRC32C: CRC of the preceding data (0: none), XXH64: seed */
+    unsigned long long csum;    /* out: checksum                             */
+} TZndkCdevCsum;
+
+/**
+ * @struct  TZndkCdevXfer
+ * @brief   in-kernel fill/move/copy of buffer ranges (ZNDKCDEV_BUF_(FILL|MOVE|COPY))
+ */
+typedef struct {
+    int           dst_ofs;      /* destination offset (as BUF_WR)              */
+    int           src_ofs;      /* MOVE/COPY: source offset                    */
+    int           len;          /* length [B]                                  */
+    int           val;          /* FILL: byte value                            */
+    int           src_minor;    /* COPY: minor # of the source device          */
+} TZndkCdevXfer;
+
+/* command queue opcodes (TZndkCdevSqe.op) */
+#define  ZNDKCDEV_OP_NOP                0 /* complete w/ res = 0                   */
+#define  ZNDKCDEV_OP_BUF_RD             1 /* as ZNDKCDEV_BUF_RD  : addr = buffer   */
+#define  ZNDKCDEV_OP_BUF_WR             2 /* as ZNDKCDEV_BUF_WR  : addr = buffer   */
+#define  ZNDKCDEV_OP_BUF_FILL           3 /* as ZNDKCDEV_BUF_FILL: val  = byte     */
+#define  ZNDKCDEV_OP_BUF_CSUM           4 /* as ZNDKCDEV_BUF_CSUM: val  = algo, addr = seed, cqe val = csum */
+#define  ZNDKCDEV_OP_NOTIFY             5 /* as ZNDKCDEV_SIGNAL  : addr = pid, val = si_int */
+
+/**
+ * @struct  TZndkCdevSqe
+ * @brief   submission queue entry (filled by user space)
+ */
+typedef struct {
+    unsigned long long user_data; /* copied to the completion as is        */
+    unsigned long long addr;    /* per op: user buffer, seed or pid          */
+    int           op;           /* ZNDKCDEV_OP_*                             */
+    int           ofs;          /* offset in the buffer                      */
+    int           len;          /* length [B]                                */
+    int           val;          /* per op: fill byte, algo or si_int         */
+} TZndkCdevSqe;
+
+/**
+ * @struct  TZndkCdevCqe
+ * @brief   completion queue entry (filled by the driver)
+ */
+typedef struct {
+    unsigned long long user_data; /* of the submission                     */
+    unsigned long long val;     /* OP_BUF_CSUM: checksum                     */
+    int           res;          /* 0 or -errno                               */
+    int           rsvd;
+} TZndkCdevCqe;
+
+/**
+ * @struct  TZndkCdevCmdqHdr
+ * @brief   head of the command queue region, mmap'able at ZNDKCDEV_CMDQ_OFS
+ *
+ * @note    user space fills sqe[sq_tail & sq_mask] and then advances sq_tail
+ *          (release); the driver consumes up to sq_tail, posts a cqe at
+ *          cq_tail & cq_mask per command and advances sq_head/cq_tail (release);
+ *          user space reaps up to cq_tail and advances cq_head. a full CQ
+ *          holds back the SQ (no completion is ever dropped)
+ */
+typedef struct {
+    unsigned int  sq_head;      /* driver: next SQE to consume               */
+    unsigned int  sq_tail;      /* user  : next SQE to fill                  */
+    unsigned int  cq_head;      /* user  : next CQE to reap                  */
+    unsigned int  cq_tail;      /* driver: next CQE to post                  */
+    unsigned int  sq_mask;      /* # of SQEs - 1                             */
+    unsigned int  cq_mask;      /* # of CQEs - 1                             */
+    unsigned int  sq_ofs;       /* offset of TZndkCdevSqe[] in the region    */
+    unsigned int  cq_ofs;       /* offset of TZndkCdevCqe[] in the region    */
+    unsigned int  flags;        /* driver: ZNDKCDEV_CMDQ_NEED_WAKEUP         */
+    unsigned int  n_cq_full;    /* driver: # of stalls on a full CQ          */
+} TZndkCdevCmdqHdr;
+
+#define  ZNDKCDEV_CMDQ_NEED_WAKEUP 0x0001 /* poller sleeps: ZNDKCDEV_CMDQ_ENTER to wake it up */
+#define  ZNDKCDEV_CMDQ_MAX_ENTRIES   4096 /* max # of SQEs                            */
+#define  ZNDKCDEV_CMDQ_MAX_IDLE_MS  10000 /* max poller spin before sleeping [ms]     */
+#define  ZNDKCDEV_CMDQ_OFS         (ZNDKCDEV_MAX_BUF + 0x100000) /* mmap offset of the region */
+
+/**
+ * @struct  TZndkCdevCmdqSetup
+ * @brief   command queue creation (ZNDKCDEV_CMDQ_SETUP, once per open file)
+ *
+ * @note    sq_cpu must be a CPU the caller may run on (any w/ CAP_SYS_NICE: else
+ *          EPERM) and sq_idle_ms at most ZNDKCDEV_CMDQ_MAX_IDLE_MS (else EINVAL)
+ */
+typedef struct {
+    int           sq_entries;   /* in: # of SQEs (rounded up to a power of 2), out */
+    int           cq_entries;   /* in: # of CQEs (0: 2 * sq_entries), out          */
+    int           sq_cpu;       /* in: CPU of the polling thread (-1: no thread)   */
+    int           sq_idle_ms;   /* in: poller idle time before sleeping (0: 1000)  */
+    int           len;          /* out: size of the region to mmap [B]             */
+} TZndkCdevCmdqSetup;
+
+/**
+ * @struct  TZndkCdevRec
+ * @brief   head of a record written by the synthetic producer (ZNDKCDEV_GEN_START),
+ *          followed by len - sizeof(TZndkCdevRec) bytes of (seq & 0xff)
+ *
+ * @note    FLAT: records fill the buffer from offset 0 and wrap around to it;
+ *          FIFO: records are queued whole (dropped if they don't fit);
+ *          FLIP: each tick writes its records to the back frame from 0 and flips
+ */
+typedef struct {
+    unsigned long long seq;     /* 0, 1, 2, ... since ZNDKCDEV_GEN_START     */
+    unsigned long long t_ns;    /* CLOCK_MONOTONIC when the batch was written */
+    unsigned int  len;          /* record size incl. this head [B]           */
+    unsigned int  magic;        /* ZNDKCDEV_REC_MAGIC                        */
+} TZndkCdevRec;
+
+#define  ZNDKCDEV_REC_MAGIC    0x4345525a /* "ZREC" in memory (little endian)     */
+#define  ZNDKCDEV_GEN_MAX_REC  (1024 * 1024) /* max record size [B]               */
+
+/**
+ * @struct  TZndkCdevGen
+ * @brief   synthetic producer (ZNDKCDEV_GEN_START / ZNDKCDEV_GEN_STOP)
+ */
+typedef struct {
+    int           len_rec;      /* in : record size [B], multiple of 8, >= sizeof(TZndkCdevRec) */
+    int           period_us;    /* in : timer period [us] (0: 100)                  */
+    int           cpu;          /* in : CPU to run the producer on (-1: any)        */
+    int           rsvd;
+    unsigned long long rate;    /* in : target rate [B/s] (0: as fast as the mode takes) */
+    unsigned long long n_rec;   /* out: # of records written                        */
+    unsigned long long n_drop;  /* out: # of records due but not written (FIFO full, behind) */
+} TZndkCdevGen;
+
+/**
+ * @struct  TZndkCdevCreate
+ * @brief   device creation request (ZNDKCDEV_CTL_CREATE on /dev/zndkcdev_ctl)
+ */
+typedef struct {
+    int           minor;        /* in: minor # (-1: any), out: created */
+    int           len_buf;      /* in: buffer size (0: default), out   */
+} TZndkCdevCreate;
+
 /**
  * @struct  TSigMsg
  * @brief   signal info
@@ -50,8 +293,33 @@ typedef struct {
 #define  ZNDKCDEV_BUF_WR            _IO(ZNDKCDEV_IOCTL_BASE,  2) /* IOCTL: copy_from_user()     */
 #define  ZNDKCDEV_PRINTK            _IO(ZNDKCDEV_IOCTL_BASE,  3) /* IOCTL: printk() test        */
 #define  ZNDKCDEV_SIGNAL            _IO(ZNDKCDEV_IOCTL_BASE,  4) /* IOCTL: send signal to user  */
+#define  ZNDKCDEV_SET_MODE          _IO(ZNDKCDEV_IOCTL_BASE,  5) /* IOCTL: select device mode   */
+#define  ZNDKCDEV_GET_MODE          _IO(ZNDKCDEV_IOCTL_BASE,  6) /* IOCTL: get    device mode   */
+#define  ZNDKCDEV_BUF_RDV           _IO(ZNDKCDEV_IOCTL_BASE,  7) /* IOCTL: batch of BUF_RD      */
+#define  ZNDKCDEV_BUF_WRV           _IO(ZNDKCDEV_IOCTL_BASE,  8) /* IOCTL: batch of BUF_WR      */
+#define  ZNDKCDEV_SET_MMAP          _IO(ZNDKCDEV_IOCTL_BASE,  9) /* IOCTL: select mmap cache mode */
+#define  ZNDKCDEV_BUF_SYNC          _IO(ZNDKCDEV_IOCTL_BASE, 10) /* IOCTL: flush a buffer range   */
+#define  ZNDKCDEV_GET_BUF_LEN       _IO(ZNDKCDEV_IOCTL_BASE, 11) /* IOCTL: get buffer size [B]    */
+#define  ZNDKCDEV_BUF_RESIZE        _IO(ZNDKCDEV_IOCTL_BASE, 12) /* IOCTL: resize an idle buffer  */
+#define  ZNDKCDEV_GET_FEATURE       _IO(ZNDKCDEV_IOCTL_BASE, 13) /* IOCTL: get version & features */
+#define  ZNDKCDEV_SHARD_DRAIN       _IO(ZNDKCDEV_IOCTL_BASE, 14) /* IOCTL: drain one shard        */
+#define  ZNDKCDEV_GET_STATS         _IO(ZNDKCDEV_IOCTL_BASE, 15) /* IOCTL: get perf counters      */
+#define  ZNDKCDEV_EXPORT_DMABUF     _IO(ZNDKCDEV_IOCTL_BASE, 16) /* IOCTL: range -> dma-buf fd    */
+#define  ZNDKCDEV_FLIP              _IO(ZNDKCDEV_IOCTL_BASE, 17) /* IOCTL: publish the back frame */
+#define  ZNDKCDEV_BUF_CSUM          _IO(ZNDKCDEV_IOCTL_BASE, 18) /* IOCTL: checksum a range       */
+#define  ZNDKCDEV_BUF_FILL          _IO(ZNDKCDEV_IOCTL_BASE, 19) /* IOCTL: memset a range         */
+#define  ZNDKCDEV_BUF_MOVE          _IO(ZNDKCDEV_IOCTL_BASE, 20) /* IOCTL: memmove in the buffer  */
+#define  ZNDKCDEV_BUF_COPY          _IO(ZNDKCDEV_IOCTL_BASE, 21) /* IOCTL: copy from another minor */
+#define  ZNDKCDEV_CMDQ_SETUP        _IO(ZNDKCDEV_IOCTL_BASE, 22) /* IOCTL: create the command queue */
+#define  ZNDKCDEV_CMDQ_ENTER        _IO(ZNDKCDEV_IOCTL_BASE, 23) /* IOCTL: doorbell: run/wake the SQ */
+#define  ZNDKCDEV_GEN_START         _IO(ZNDKCDEV_IOCTL_BASE, 24) /* IOCTL: start the synthetic producer */
+#define  ZNDKCDEV_GEN_STOP          _IO(ZNDKCDEV_IOCTL_BASE, 25) /* IOCTL: stop it, get its counters */
 #define  ZNDKCDEV_TEST              _IO(ZNDKCDEV_IOCTL_BASE, 99) /* IOCTL: ioctl    test        */
 
+/* IOCTL commands for /dev/zndkcdev_ctl */
+#define  ZNDKCDEV_CTL_CREATE        _IO(ZNDKCDEV_IOCTL_BASE, 64) /* IOCTL: create  a device     */
+#define  ZNDKCDEV_CTL_DESTROY       _IO(ZNDKCDEV_IOCTL_BASE, 65) /* IOCTL: destroy a device     */
+
 #endif  /* ZNDKCDEV_H */
 
 /* end */
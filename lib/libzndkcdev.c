@@ -16,10 +16,13 @@
 
 #include <stdio.h>              /* printf()    */
 #include <stdint.h>             /* uint32_t    */
+#include <stdlib.h>             /* getenv()    */
 #include <string.h>             /* memset()    */
 #include <fcntl.h>              /* open()      */
+#include <pthread.h>            /* pthread_once() */
 #include <unistd.h>             /* close()     */
 #include <signal.h>             /* SIGNAL      */
+#include <sys/epoll.h>          /* epoll_*()   */
 #include <sys/mman.h>           /* mmap()      */
 #include <sys/ioctl.h>          /* ioctl()     */
 #include <sys/types.h>          /* pid_t       */
@@ -27,52 +30,160 @@
 #include    "zndkcdev.h"        /* zndk driver */
 #include "libzndkcdev.h"        /* zndk lib    */
 
+static const TZndkCdevBackend       *ZndkCdevBackend;   /* NULL: not selected yet */
+static pthread_once_t                ZndkCdevBackendOnce = PTHREAD_ONCE_INIT;
+
+/* fd -> handle (for the fd based API): sparse, chunks allocated on first use;
+ * lookups are lock free, FdMapMtx only serializes chunk allocation */
+#define  ZNDKCDEV_FDMAP_BITS          10
+#define  ZNDKCDEV_FDMAP_CHUNK        (1 << ZNDKCDEV_FDMAP_BITS) /* fds per chunk    */
+#define  ZNDKCDEV_FDMAP_N             4096                       /* fds < 4 Mi        */
+static TDevHandle                  **FdMap[ZNDKCDEV_FDMAP_N];
+static pthread_mutex_t               FdMapMtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* SIGNAL requests in flight: si_int carries the token of its slot, so the handler
+ * finds the callback of exactly that request w/o a lock or a scan */
+typedef struct {
+    int           token;        /* 0: free, -1: being set up, else (seq << 8) | idx */
+    int           dat;          /* caller's data, handed to sigcb()                  */
+    TSigCallback  sigcb;
+} TZndkCdevSigSlot;
+
+#define  ZNDKCDEV_N_SIG_SLOT          256 /* SIGNAL requests in flight per process */
+static TZndkCdevSigSlot              SigSlot[ZNDKCDEV_N_SIG_SLOT];
+static unsigned int                  SigSeq;
+
 /**
- * @struct TLibZndkCdevInfo
- * @brief  libzndkcdev info
+ * _get_zndkcdev_hdl()
+ * @brief    handle of an fd opened by libzndkcdev (NULL: none)
  */
-typedef struct {
-    TDevHandle   *hdl;          /* zndkcdevdriver handle info */
+static TDevHandle *
+_get_zndkcdev_hdl(int fd)
+{
+    TDevHandle **chunk;
+
+    if ((fd < 0) || ((fd >> ZNDKCDEV_FDMAP_BITS) >= ZNDKCDEV_FDMAP_N)) {
+        return  NULL;
+    }
+    chunk = __atomic_load_n(&FdMap[fd >> ZNDKCDEV_FDMAP_BITS], __ATOMIC_ACQUIRE);
+
+    return  (chunk != NULL) ? __atomic_load_n(&chunk[fd & (ZNDKCDEV_FDMAP_CHUNK - 1)], __ATOMIC_ACQUIRE) : NULL;
+}
+
+/**
+ * _set_zndkcdev_hdl()
+ * @brief    (un)register the handle of an fd (hdl = NULL: unregister)
+ * @return   0: ok, -1: fd out of range / out of memory
+ */
+static int
+_set_zndkcdev_hdl(int fd, TDevHandle *hdl)
+{
+    TDevHandle **chunk;
 
-    TSigCallback  sigcb;        /* callback() for SIGNAL      */
-} TLibZndkCdevInfo;
-static TLibZndkCdevInfo              LibZndkCdevInfo;
-#define _get_libzndkcdev_info()    (&LibZndkCdevInfo)
+    if ((fd < 0) || ((fd >> ZNDKCDEV_FDMAP_BITS) >= ZNDKCDEV_FDMAP_N)) {
+        return  -1;
+    }
+
+    pthread_mutex_lock(&FdMapMtx);
+    chunk = FdMap[fd >> ZNDKCDEV_FDMAP_BITS];
+    if (chunk == NULL) {
+        chunk = calloc(ZNDKCDEV_FDMAP_CHUNK, sizeof(TDevHandle *));
+        if (chunk == NULL) {
+            pthread_mutex_unlock(&FdMapMtx);
+            return  -1;
+        }
+        __atomic_store_n(&FdMap[fd >> ZNDKCDEV_FDMAP_BITS], chunk, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&chunk[fd & (ZNDKCDEV_FDMAP_CHUNK - 1)], hdl, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&FdMapMtx);
 
-static TDevHandle                    DevHandle;
-#define _get_zndkcdev_hdl()        (&DevHandle)
+    return  0;
+}
 
 /**
- * _init_libzndkcdev_info()
- * @brief    LibZndkCdevInfo intialisation
+ * _init_zndkcdev_backend()
+ * @brief    default backend: $ZNDKCDEV_BACKEND, else "dev" (once per process)
  *
  * @param    - none -
  * @return   - none -
  */
-static int
-_init_libzndkcdev_info(TLibZndkCdevInfo *info)
+static void
+_init_zndkcdev_backend(void)
+{
+    const char *env = getenv(ZNDKCDEV_BACKEND_ENV);
+
+    if (__atomic_load_n(&ZndkCdevBackend, __ATOMIC_ACQUIRE) == NULL) {
+        __atomic_store_n(&ZndkCdevBackend,
+                         ((env != NULL) && (strcmp(env, zndkcdev_backend_shm.name) == 0))
+                         ? &zndkcdev_backend_shm : &zndkcdev_backend_dev, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * _get_zndkcdev_backend()
+ * @brief    backend for new opens: zndkcdev_set_backend(), else $ZNDKCDEV_BACKEND, else "dev"
+ *
+ * @param    - none -
+ * @return         *be TZndkCdevBackend ::= backend
+ */
+static const TZndkCdevBackend *
+_get_zndkcdev_backend(void)
 {
-    int         stat = 0;
-    TDevHandle *hdl;
+    pthread_once(&ZndkCdevBackendOnce, _init_zndkcdev_backend);
 
-    /* init handle info */
-    hdl            = _get_zndkcdev_hdl();
-    memset(hdl, 0, sizeof(TDevHandle));
-    hdl->fd        = -1;
+    return  __atomic_load_n(&ZndkCdevBackend, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * _get_zndkcdev_fd_backend()
+ * @brief    backend an fd was opened through (fds not opened by libzndkcdev: the current one)
+ */
+static inline const TZndkCdevBackend *
+_get_zndkcdev_fd_backend(int fd)
+{
+    TDevHandle *hdl = _get_zndkcdev_hdl(fd);
+
+    return  ((hdl != NULL) && (hdl->be != NULL)) ? hdl->be : _get_zndkcdev_backend();
+}
+
+/**
+ * _zndkcdev_ioctl()
+ * @brief    pass a ZNDKCDEV_* command to the backend of the fd
+ */
+static inline int
+_zndkcdev_ioctl(int fd, unsigned long cmd, void *arg)
+{
+    return  _get_zndkcdev_fd_backend(fd)->ioctl(fd, cmd, arg);
+}
+
+/**
+ * _zndkcdev_hdl_attach()
+ * @brief    set up the handle of a freshly opened fd
+ */
+static TDevHandle *
+_zndkcdev_hdl_attach(int fd, const TZndkCdevBackend *be)
+{
+    TDevHandle *hdl = calloc(1, sizeof(TDevHandle));
+
+    if ((hdl == NULL) || (_set_zndkcdev_hdl(fd, hdl) < 0)) {
+        printf(" %s(): error: no handle for fd %d\n", __func__, fd);
+        free(hdl);
+        be->close(fd);
+        return  NULL;
+    }
+
+    hdl->fd        =  fd;
     hdl->buf_virt  =  NULL;
     hdl->len_buf   =  LEN_ZNDKCDEV_BUF;
+    hdl->be        =  be;
 
-    /* int lib info */
-    memset(info, 0, sizeof(TLibZndkCdevInfo));
-    info->hdl      =  hdl;
-    info->sigcb    = (void *)NULL;
-
-    return  stat;
+    return  hdl;
 }
 
 /**
  * _zndkcdev_sigaction()
- * @brief    sa_sigaction routine
+ * @brief    sa_sigaction routine: async-signal-safe, runs the callback of the request
+ *           the token in si_int names (SIGUSR1s w/o a live token are ignored)
  *
  * @param    [in]   signum      int ::= SIGNAL #
  * @param    [in]  *sinfo siginfo_t ::= siginfo_t
@@ -82,120 +193,222 @@ _init_libzndkcdev_info(TLibZndkCdevInfo *info)
 static void
 _zndkcdev_sigaction(int signum, siginfo_t *sinfo, void *xtra)
 {
-    TLibZndkCdevInfo *info  = _get_libzndkcdev_info();
-    TSigCallback      sigcb =  info->sigcb;
+    int               token = sinfo->si_int;
+    TZndkCdevSigSlot *slot;
+    TSigCallback      sigcb;
+    int               dat;
+
+    if (token <= 0) {
+        return;
+    }
+    slot  = &SigSlot[token & (ZNDKCDEV_N_SIG_SLOT - 1)];
+    if (__atomic_load_n(&slot->token, __ATOMIC_ACQUIRE) != token) {
+        return;
+    }
+    sigcb = slot->sigcb;
+    dat   = slot->dat;
+    if (__atomic_compare_exchange_n(&slot->token, &token, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        sigcb(signum, dat);     /* the slot was still ours: nobody reused it meanwhile */
+    }
+}
 
-    printf(" %s(): got the SIGNAL, signum=%d, si_int=%d\n", __func__, signum, sinfo->si_int);
+/**
+ * _zndkcdev_sig_claim()
+ * @brief    take a SIGNAL slot for {sigcb, dat}
+ * @return   token to send as si_int (-1: all slots in flight)
+ */
+static int
+_zndkcdev_sig_claim(TSigCallback sigcb, int dat)
+{
+    unsigned int      seq = __atomic_add_fetch(&SigSeq, 1, __ATOMIC_RELAXED);
+    int               idx;
+    int               token;
+    int               free_tok;
 
-    if (sigcb != NULL) {
-        sigcb(signum, sinfo->si_int);
-    } else {
-        printf(" %s(): no sigcb() found\n", __func__);
+    for (idx = 0; idx < ZNDKCDEV_N_SIG_SLOT; idx++) {
+        free_tok = 0;
+        if (__atomic_compare_exchange_n(&SigSlot[idx].token, &free_tok, -1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            token              = (int)(((seq % 0x7fffff) + 1) << 8) | idx; /* > 0 */
+            SigSlot[idx].sigcb = sigcb;
+            SigSlot[idx].dat   = dat;
+            __atomic_store_n(&SigSlot[idx].token, token, __ATOMIC_RELEASE);
+            return  token;
+        }
     }
+
+    return  -1;
 }
 
 /**
- * zndkcdev_open()
- * @brief    open the zndkcdev driver
+ * zndkcdev_set_backend()
+ * @brief    select the transport of the following zndkcdev_open()/zndkcdev_ctl_open()
  *
- * @param    [in]  *filepath       char ::= /dev/<filename>
+ * @note     devices opened before keep the backend they were opened through
+ *
+ * @param    [in]  *be TZndkCdevBackend ::= &zndkcdev_backend_(dev|shm), or a custom one
  * @return          stat            int ::= process status
  */
 int
-zndkcdev_open(const char *filepath)
+zndkcdev_set_backend(const TZndkCdevBackend *be)
+{
+    if ((be == NULL) || (be->open == NULL) || (be->close == NULL) || (be->ioctl == NULL) ||
+        (be->mmap == NULL) || (be->munmap == NULL)) {
+        printf(" %s(): error: incomplete backend\n", __func__);
+        return  -1;
+    }
+    pthread_once(&ZndkCdevBackendOnce, _init_zndkcdev_backend);
+    __atomic_store_n(&ZndkCdevBackend, be, __ATOMIC_RELEASE);
+
+    return  0;
+}
+
+/**
+ * zndkcdev_get_backend()
+ * @brief    get the backend in use
+ *
+ * @param    - none -
+ * @return         *be TZndkCdevBackend ::= backend
+ */
+const TZndkCdevBackend *
+zndkcdev_get_backend(void)
+{
+    return  _get_zndkcdev_backend();
+}
+
+/**
+ * zndkcdev_hdl_open()
+ * @brief    open the zndkcdev driver and get an independent handle for it
+ *
+ * @note     handles of different devices (or opens) share nothing and may be
+ *           used from different threads at the same time
+ *
+ * @param    [in]  *filepath       char ::= /dev/<filename>
+ * @return         *hdl      TDevHandle ::= handle (NULL: error)
+ */
+TDevHandle *
+zndkcdev_hdl_open(const char *filepath)
 {
-    int               fd;
-    TLibZndkCdevInfo *info = _get_libzndkcdev_info();
-    TDevHandle       *hdl;
+    const TZndkCdevBackend *be = _get_zndkcdev_backend();
+    TDevHandle             *hdl;
+    int                     fd;
 
     printf(" %s(): open\n", __func__);
 
     /* open the cdev */
-    fd       = open(filepath, O_RDWR);
+    fd       = be->open(filepath, O_RDWR);
     if (fd   < 0) {
         printf(" %s(): open error, file = %s (%d)\n", __func__, filepath, fd);
-        return  fd;
+        return  NULL;
     }
 
-    _init_libzndkcdev_info(info);
-    hdl      = info->hdl;
-    hdl->fd  = fd;
+    hdl      = _zndkcdev_hdl_attach(fd, be);
+    if (hdl == NULL) {
+        return  NULL;
+    }
+
+    /* the buffer size is a module parameter: ask the driver */
+    if (be->ioctl(fd, ZNDKCDEV_GET_BUF_LEN, &hdl->len_buf) < 0) {
+        printf(" %s(): error: ioctl (get buffer length)\n", __func__);
+    }
 
-    return  fd;
+    return  hdl;
 }
 
 /**
- * zndkcdev_close()
- * @brief    close the zndkcdev driver
+ * zndkcdev_hdl_close()
+ * @brief    unmap and close a handle, and free it (drop its windows first)
  *
- * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]  *hdl      TDevHandle ::= handle
  * @return          stat            int ::= process status
  */
 int
-zndkcdev_close(int fd)
+zndkcdev_hdl_close(TDevHandle *hdl)
 {
-    int               stat = 0;
-    TLibZndkCdevInfo *info = _get_libzndkcdev_info();
-    TDevHandle       *hdl  = info->hdl;
+    int     stat = 0;
 
     printf(" %s(): close\n", __func__);
 
-    /* un-map */
-    if (hdl->buf_virt != NULL) {
-        stat = munmap(hdl->buf_virt, hdl->len_buf);
-        if (stat < 0) {
-            printf(" %s(): munmap error (%d)\n", __func__, stat);
-        }
+    if (hdl == NULL) {
+        return  -1;
     }
 
-    /* close the cdev */
-    close(fd);
+    /* un-map */
+    zndkcdev_hdl_munmap(hdl);
+
+    /* close the cdev: unregister first, the fd # may be reused by anyone after close() */
+    _set_zndkcdev_hdl(hdl->fd, NULL);
+    stat     = hdl->be->close(hdl->fd);
+    free(hdl);
 
     return  stat;
 }
 
 /**
- * zndkcdev_mmap()
- * @brief    create a new mapping in the virtual address (user space)
+ * zndkcdev_hdl_get()
+ * @brief    get the handle of an fd returned by zndkcdev_open()
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @return         *hdl      TDevHandle ::= handle (NULL: not opened by libzndkcdev)
+ */
+TDevHandle *
+zndkcdev_hdl_get(int fd)
+{
+    return  _get_zndkcdev_hdl(fd);
+}
+
+/**
+ * zndkcdev_hdl_mmap()
+ * @brief    map the buffer of a handle (once; later calls return the same mapping)
+ *
+ * @param    [in]  *hdl      TDevHandle ::= handle
+ * @return         *map         uint8_t ::= mapped buffer (NULL: error)
  */
 uint8_t *
-zndkcdev_mmap(int fd)
+zndkcdev_hdl_mmap(TDevHandle *hdl)
 {
-    TLibZndkCdevInfo *info = _get_libzndkcdev_info();
-    TDevHandle       *hdl  =  info->hdl;
-    uint8_t          *map  =  NULL;
+    uint8_t *map;
 
     printf(" %s(): mmap\n", __func__);
 
+    if ((hdl == NULL) || (hdl->fd < 0)) {
+        return  NULL;
+    }
+
     /* mmap the file to get access to driver memory buffer */
     if (hdl->buf_virt == NULL) {
-      map      = mmap(NULL, hdl->len_buf, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-      if (map == MAP_FAILED) {
-          printf(" %s(): mapping error\n", __func__);
-          return  NULL;
-      }
-      hdl->buf_virt = map;
+        map      = hdl->be->mmap(hdl->fd, hdl->len_buf, 0, PROT_READ | PROT_WRITE, 0);
+        if (map == MAP_FAILED) {
+            printf(" %s(): mapping error\n", __func__);
+            return  NULL;
+        }
+        hdl->buf_virt = map;
     }
 
-    return  map;
+    return  hdl->buf_virt;
 }
 
 /**
- * zndkcdev_munmap()
- * @brief    create a new mapping in the virtual address (user space)
+ * zndkcdev_hdl_munmap()
+ * @brief    unmap the buffer of a handle
+ *
+ * @param    [in]  *hdl      TDevHandle ::= handle
+ * @return          stat            int ::= process status
  */
 int
-zndkcdev_munmap(int fd)
+zndkcdev_hdl_munmap(TDevHandle *hdl)
 {
-    int               stat = 0;
-    TLibZndkCdevInfo *info = _get_libzndkcdev_info();
-    TDevHandle       *hdl  =  info->hdl;
+    int     stat = 0;
 
-    printf(" %s(): mmap\n", __func__);
+    if ((hdl == NULL) || (hdl->fd < 0)) {
+        return  -1;
+    }
 
-    /* un-map */
+    if (hdl->flip_ctl != NULL) {
+        hdl->be->munmap(hdl->fd, (void *)hdl->flip_ctl, sysconf(_SC_PAGESIZE));
+        hdl->flip_ctl = NULL;
+    }
     if (hdl->buf_virt != NULL) {
-        stat = munmap(hdl->buf_virt, hdl->len_buf);
+        stat = hdl->be->munmap(hdl->fd, hdl->buf_virt, hdl->len_buf);
         if (stat < 0) {
             printf(" %s(): munmap error (%d)\n", __func__, stat);
             stat = -1;
@@ -208,73 +421,175 @@ zndkcdev_munmap(int fd)
 }
 
 /**
- * zndkcdev_get_version()
- * @brief    get the version of the zndkcdev driver via ioctl
+ * zndkcdev_hdl_mmap_window()
+ * @brief    map only [ofs, ofs + len) of the buffer of a handle (any # of windows per handle)
  *
- * @param    [in]   fd              int ::= file descriptor
- * @param    [out] *ver            char ::= device driver version string
+ * @param    [in]  *hdl      TDevHandle ::= handle
+ * @param    [in]   ofs             int ::= offset in the buffer (page aligned)
+ * @param    [in]   len             int ::= length of the window
+ * @return         *win TZndkCdevWindow ::= window (NULL: error)
+ */
+TZndkCdevWindow *
+zndkcdev_hdl_mmap_window(TDevHandle *hdl, int ofs, int len)
+{
+    TZndkCdevWindow *win;
+    uint8_t         *map;
+
+    if ((hdl == NULL) || (hdl->fd < 0) || (ofs < 0) || (len <= 0) ||
+        (ofs % sysconf(_SC_PAGESIZE)) || (len > hdl->len_buf - ofs)) {
+        printf(" %s(): error: bad window (ofs=%d, len=%d)\n", __func__, ofs, len);
+        return  NULL;
+    }
+
+    win = malloc(sizeof(TZndkCdevWindow));
+    if (win == NULL) {
+        return  NULL;
+    }
+
+    map = hdl->be->mmap(hdl->fd, len, ofs, PROT_READ | PROT_WRITE, 0);
+    if (map == MAP_FAILED) {
+        printf(" %s(): mapping error\n", __func__);
+        free(win);
+        return  NULL;
+    }
+    win->hdl = hdl;
+    win->map = map;
+    win->ofs = ofs;
+    win->len = len;
+
+    return  win;
+}
+
+/**
+ * zndkcdev_hdl_munmap_window()
+ * @brief    unmap and free a window
+ *
+ * @param    [in]  *win TZndkCdevWindow ::= window
  * @return          stat            int ::= process status
  */
 int
-zndkcdev_get_version(int fd, char *ver)
+zndkcdev_hdl_munmap_window(TZndkCdevWindow *win)
 {
-    int     stat = 0;
+    int     stat;
 
-    printf(" %s(): ioctl: get vresion\n", __func__);
+    if (win == NULL) {
+        return  -1;
+    }
 
-    stat = ioctl(fd, ZNDKCDEV_GET_VERSION, ver);
+    stat = win->hdl->be->munmap(win->hdl->fd, win->map, win->len);
     if (stat < 0) {
-        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+        printf(" %s(): munmap error (%d)\n", __func__, stat);
     }
+    free(win);
 
     return  stat;
 }
 
 /**
- * zndkcdev_buf_read()
- * @brief    read data from buffer of the zndkcdev driver via ioctl
+ * zndkcdev_open()
+ * @brief    open the zndkcdev driver
+ *
+ * @param    [in]  *filepath       char ::= /dev/<filename>
+ * @return          fd              int ::= file descriptor (zndkcdev_hdl_get() gives its handle)
+ */
+int
+zndkcdev_open(const char *filepath)
+{
+    TDevHandle *hdl = zndkcdev_hdl_open(filepath);
+
+    return  (hdl != NULL) ? hdl->fd : -1;
+}
+
+/**
+ * zndkcdev_close()
+ * @brief    close the zndkcdev driver
  *
  * @param    [in]   fd              int ::= file descriptor
- * @param    [in]   ofs             int ::= offset address from top of driver buffer
- * @param    [in]   len             int ::= length to be read
- * @param    [out] *rbuf           void ::= read buffer
  * @return          stat            int ::= process status
  */
 int
-zndkcdev_buf_read(int fd, int ofs, int len, const void *rbuf)
+zndkcdev_close(int fd)
 {
-    int           stat = 0;
-    TZndkCdevMem  mem = { (void *)rbuf, ofs, len };
+    return  zndkcdev_hdl_close(zndkcdev_hdl_get(fd));
+}
 
-    printf(" %s(): ioctl: read buffer\n", __func__);
+/**
+ * zndkcdev_ctl_open()
+ * @brief    open the zndkcdev control device (/dev/zndkcdev_ctl)
+ *
+ * @param    - none -
+ * @return          fd              int ::= file descriptor of the control device
+ */
+int
+zndkcdev_ctl_open(void)
+{
+    const TZndkCdevBackend *be = _get_zndkcdev_backend();
+    int                     fd;
+
+    fd = be->open(ZNDKCDEV_CTL_PATH, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        printf(" %s(): open error, file = %s (%d)\n", __func__, ZNDKCDEV_CTL_PATH, fd);
+        return  fd;
+    }
+
+    return  (_zndkcdev_hdl_attach(fd, be) != NULL) ? fd : -1;
+}
+
+/**
+ * zndkcdev_ctl_close()
+ * @brief    close the zndkcdev control device
+ *
+ * @param    [in]   ctl_fd          int ::= file descriptor of the control device
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_ctl_close(int ctl_fd)
+{
+    return  zndkcdev_hdl_close(zndkcdev_hdl_get(ctl_fd));
+}
+
+/**
+ * zndkcdev_dev_create()
+ * @brief    create a device /dev/zndkcdev_<minor> via the control device
+ *
+ * @param    [in]   ctl_fd          int ::= file descriptor of the control device
+ * @param    [in]   minor           int ::= minor # to create (-1: any free one)
+ * @param    [in]   len_buf         int ::= buffer size (unit: [B], 0: module default)
+ * @return          minor           int ::= minor # created (< 0: error)
+ */
+int
+zndkcdev_dev_create(int ctl_fd, int minor, int len_buf)
+{
+    int              stat = 0;
+    TZndkCdevCreate  crt  = { minor, len_buf };
+
+    printf(" %s(): ioctl: create (minor=%d, len_buf=%d)\n", __func__, minor, len_buf);
 
-    stat = ioctl(fd, ZNDKCDEV_BUF_RD, &mem);
+    stat = _zndkcdev_ioctl(ctl_fd, ZNDKCDEV_CTL_CREATE, &crt);
     if (stat < 0) {
         printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+        return  stat;
     }
 
-    return  stat;
+    return  crt.minor;
 }
 
 /**
- * zndkcdev_buf_write()
- * @brief    write data to buffer of the zndkcdev driver via ioctl
+ * zndkcdev_dev_destroy()
+ * @brief    destroy an idle device /dev/zndkcdev_<minor> via the control device
  *
- * @param    [in]   fd              int ::= file descriptor
- * @param    [in]   ofs             int ::= offset address from top of driver buffer
- * @param    [in]   len             int ::= length to be written
- * @param    [in]  *wbuf           void ::= write buffer
- * @return          stat            int ::= process status
+ * @param    [in]   ctl_fd          int ::= file descriptor of the control device
+ * @param    [in]   minor           int ::= minor # to destroy
+ * @return          stat            int ::= process status (EBUSY while opened or mapped)
  */
 int
-zndkcdev_buf_write(int fd, int ofs, int len, void *wbuf)
+zndkcdev_dev_destroy(int ctl_fd, int minor)
 {
-    int           stat = 0;
-    TZndkCdevMem  mem = { (void *)wbuf, ofs, len };
+    int     stat = 0;
 
-    printf(" %s(): ioctl: buf write\n", __func__);
+    printf(" %s(): ioctl: destroy (minor=%d)\n", __func__, minor);
 
-    stat = ioctl(fd, ZNDKCDEV_BUF_WR, &mem);
+    stat = _zndkcdev_ioctl(ctl_fd, ZNDKCDEV_CTL_DESTROY, (void *)(unsigned long)minor);
     if (stat < 0) {
         printf(" %s(): error: ioctl (%d)\n", __func__, stat);
     }
@@ -283,21 +598,32 @@ zndkcdev_buf_write(int fd, int ofs, int len, void *wbuf)
 }
 
 /**
- * zndkcdev_print()
- * @brief    print a message by the zndkcdev driver via ioctl (dmesg)
+ * zndkcdev_mmap()
+ * @brief    create a new mapping in the virtual address (user space)
+ */
+uint8_t *
+zndkcdev_mmap(int fd)
+{
+    return  zndkcdev_hdl_mmap(zndkcdev_hdl_get(fd));
+}
+
+/**
+ * zndkcdev_set_mmap_mode()
+ * @brief    select the cache mode of the following zndkcdev_mmap() on this fd
+ *           (WC/UC: x86 only, and not for 2 MiB page buffers)
  *
- * @param    - none -
  * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   mode            int ::= ZNDKCDEV_MMAP_(WB|WC|UC)
  * @return          stat            int ::= process status
  */
 int
-zndkcdev_print(int fd, const char *msg)
+zndkcdev_set_mmap_mode(int fd, int mode)
 {
     int     stat = 0;
 
-    printf(" %s(): ioctl: printk() \n", __func__);
+    printf(" %s(): ioctl: set mmap mode (%d)\n", __func__, mode);
 
-    stat = ioctl(fd, ZNDKCDEV_PRINTK, msg);
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_SET_MMAP, (void *)(unsigned long)mode);
     if (stat < 0) {
         printf(" %s(): error: ioctl (%d)\n", __func__, stat);
     }
@@ -306,32 +632,22 @@ zndkcdev_print(int fd, const char *msg)
 }
 
 /**
- * zndkcdev_send_signal()
- * @brief    send a SIGNAL from the zndkcdev driver via ioctl
+ * zndkcdev_buf_sync()
+ * @brief    flush CPU caches of a range of the mapped buffer via ioctl
+ *           (x86 only: fails w/ EOPNOTSUPP elsewhere)
  *
  * @param    [in]   fd              int ::= file descriptor
- * @param    - none -
+ * @param    [in]   ofs             int ::= offset address from top of driver buffer
+ * @param    [in]   len             int ::= length to be flushed
  * @return          stat            int ::= process status
  */
 int
-zndkcdev_send_signal(int fd, TSigCallback sigcb, pid_t pid, int dat)
+zndkcdev_buf_sync(int fd, int ofs, int len)
 {
-    int               stat   =   0;
-    TLibZndkCdevInfo *info   =  _get_libzndkcdev_info();
-    struct sigaction  sa;
-    TSigMsg           sigmsg = { pid, dat };
-
-    printf(" %s(): ioctl: signal\n", __func__);
-
-    /* prepare for the sigaction */
-    info->sigcb     = sigcb;
-    memset(&sa, 0, sizeof(struct sigaction));
-    sa.sa_sigaction = _zndkcdev_sigaction;
-    sa.sa_flags     =  SA_SIGINFO;
-    sigaction(SIGUSR1, &sa, NULL);
+    int           stat = 0;
+    TZndkCdevMem  mem  = { NULL, ofs, len };
 
-    /* request the driver to send a SIGNAL */
-    stat = ioctl(fd, ZNDKCDEV_SIGNAL, &sigmsg);
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_SYNC, &mem);
     if (stat < 0) {
         printf(" %s(): error: ioctl (%d)\n", __func__, stat);
     }
@@ -339,6 +655,745 @@ zndkcdev_send_signal(int fd, TSigCallback sigcb, pid_t pid, int dat)
     return  stat;
 }
 
+/**
+ * zndkcdev_munmap()
+ * @brief    create a new mapping in the virtual address (user space)
+ */
+int
+zndkcdev_munmap(int fd)
+{
+    return  zndkcdev_hdl_munmap(zndkcdev_hdl_get(fd));
+}
+
+/**
+ * zndkcdev_get_version()
+ * @brief    get the version of the zndkcdev driver via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *ver            char ::= device driver version string
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_get_version(int fd, char *ver)
+{
+    int     stat = 0;
+
+    printf(" %s(): ioctl: get vresion\n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GET_VERSION, ver);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_get_feature()
+ * @brief    get the version and features (e.g., huge page mapping) of the zndkcdev driver via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *feat TZndkCdevFeature ::= version & features
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_get_feature(int fd, TZndkCdevFeature *feat)
+{
+    int     stat = 0;
+
+    printf(" %s(): ioctl: get feature\n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GET_FEATURE, feat);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_get_stats()
+ * @brief    get the per-device performance counters and latency histograms via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *stats TZndkCdevStats ::= counters indexed by ZNDKCDEV_STAT_*
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_get_stats(int fd, TZndkCdevStats *stats)
+{
+    int     stat = 0;
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GET_STATS, stats);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_get_buf_len()
+ * @brief    get the buffer size of the zndkcdev driver via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *len             int ::= buffer size (unit: [B])
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_get_buf_len(int fd, int *len)
+{
+    int     stat = 0;
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GET_BUF_LEN, len);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_resize()
+ * @brief    resize the buffer of an idle zndkcdev device via ioctl
+ *
+ * @note     fails (EBUSY) while the buffer is mapped or the device is opened by others
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   len             int ::= new buffer size (unit: [B], page aligned by the driver)
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_resize(int fd, int len)
+{
+    int               stat = 0;
+    TDevHandle       *hdl  =  zndkcdev_hdl_get(fd);
+
+    printf(" %s(): ioctl: resize buffer (%d)\n", __func__, len);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_RESIZE, (void *)(unsigned long)len);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+        return  stat;
+    }
+
+    if (hdl != NULL) {
+        stat = zndkcdev_get_buf_len(fd, &hdl->len_buf);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_read()
+ * @brief    read data from buffer of the zndkcdev driver via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   ofs             int ::= offset address from top of driver buffer
+ * @param    [in]   len             int ::= length to be read
+ * @param    [out] *rbuf           void ::= read buffer
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_read(int fd, int ofs, int len, const void *rbuf)
+{
+    int           stat = 0;
+    TZndkCdevMem  mem = { (void *)rbuf, ofs, len };
+
+    printf(" %s(): ioctl: read buffer\n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_RD, &mem);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_write()
+ * @brief    write data to buffer of the zndkcdev driver via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   ofs             int ::= offset address from top of driver buffer
+ * @param    [in]   len             int ::= length to be written
+ * @param    [in]  *wbuf           void ::= write buffer
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_write(int fd, int ofs, int len, void *wbuf)
+{
+    int           stat = 0;
+    TZndkCdevMem  mem = { (void *)wbuf, ofs, len };
+
+    printf(" %s(): ioctl: buf write\n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_WR, &mem);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_readv()
+ * @brief    read a batch of segments from buffer of the zndkcdev driver via one ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]  *mem    TZndkCdevMem ::= segments {rbuf, ofs, len}
+ * @param    [out] *stat            int ::= per-segment status: 0/-errno (NULL: ignore)
+ * @param    [in]   n_mem           int ::= # of segments (<= ZNDKCDEV_MEMVEC_MAX)
+ * @return          n_err           int ::= # of failed segments (< 0: ioctl error)
+ */
+int
+zndkcdev_buf_readv(int fd, TZndkCdevMem *mem, int *stat, int n_mem)
+{
+    int              n_err;
+    TZndkCdevMemVec  vec = { mem, stat, n_mem };
+
+    n_err = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_RDV, &vec);
+    if (n_err < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, n_err);
+    }
+
+    return  n_err;
+}
+
+/**
+ * zndkcdev_buf_writev()
+ * @brief    write a batch of segments to buffer of the zndkcdev driver via one ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]  *mem    TZndkCdevMem ::= segments {wbuf, ofs, len}
+ * @param    [out] *stat            int ::= per-segment status: 0/-errno (NULL: ignore)
+ * @param    [in]   n_mem           int ::= # of segments (<= ZNDKCDEV_MEMVEC_MAX)
+ * @return          n_err           int ::= # of failed segments (< 0: ioctl error)
+ */
+int
+zndkcdev_buf_writev(int fd, TZndkCdevMem *mem, int *stat, int n_mem)
+{
+    int              n_err;
+    TZndkCdevMemVec  vec = { mem, stat, n_mem };
+
+    n_err = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_WRV, &vec);
+    if (n_err < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, n_err);
+    }
+
+    return  n_err;
+}
+
+/**
+ * zndkcdev_print()
+ * @brief    print a message by the zndkcdev driver via ioctl (dmesg)
+ *
+ * @param    - none -
+ * @param    [in]   fd              int ::= file descriptor
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_print(int fd, const char *msg)
+{
+    int     stat = 0;
+
+    printf(" %s(): ioctl: printk() \n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_PRINTK, (void *)msg);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_send_signal()
+ * @brief    send a SIGNAL from the zndkcdev driver via ioctl
+ *
+ * @note     to this process (pid == getpid()) the SIGNAL carries a token in si_int
+ *           and sigcb(signum, dat) runs for exactly this request, in signal
+ *           handler context (async-signal-safe calls only); to another process
+ *           si_int is dat as is
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   sigcb  TSigCallback ::= callback (pid == getpid())
+ * @param    [in]   pid           pid_t ::= process to signal
+ * @param    [in]   dat             int ::= user data
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_send_signal(int fd, TSigCallback sigcb, pid_t pid, int dat)
+{
+    int               stat   =   0;
+    int               is_own = (sigcb != NULL) && (pid == getpid());
+    struct sigaction  sa;
+    TSigMsg           sigmsg = { pid, dat };
+
+    printf(" %s(): ioctl: signal\n", __func__);
+
+    /* prepare for the sigaction: the token names this request */
+    memset(&sa, 0, sizeof(struct sigaction));
+    sa.sa_sigaction = _zndkcdev_sigaction;
+    sa.sa_flags     =  SA_SIGINFO;
+    sigaction(SIGUSR1, &sa, NULL);
+    if (is_own) {
+        sigmsg.dat  = _zndkcdev_sig_claim(sigcb, dat); /* before: it may arrive in the ioctl */
+        if (sigmsg.dat < 0) {
+            printf(" %s(): error: %d SIGNAL requests in flight\n", __func__, ZNDKCDEV_N_SIG_SLOT);
+            return  -1;
+        }
+    }
+
+    /* request the driver to send a SIGNAL */
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_SIGNAL, &sigmsg);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+        if (is_own) {           /* unless the handler got it after all */
+            __atomic_compare_exchange_n(&SigSlot[sigmsg.dat & (ZNDKCDEV_N_SIG_SLOT - 1)].token, &sigmsg.dat, 0,
+                                        0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_set_mode()
+ * @brief    select the device mode (flat buffer / FIFO) via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   mode            int ::= ZNDKCDEV_MODE_(FLAT|FIFO)
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_set_mode(int fd, int mode)
+{
+    int     stat = 0;
+
+    printf(" %s(): ioctl: set mode (%d)\n", __func__, mode);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_SET_MODE, (void *)(unsigned long)mode);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_get_mode()
+ * @brief    get the current device mode via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *mode            int ::= ZNDKCDEV_MODE_(FLAT|FIFO|SHARD)
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_get_mode(int fd, int *mode)
+{
+    int     stat = 0;
+
+    printf(" %s(): ioctl: get mode\n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GET_MODE, mode);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_shard_drain()
+ * @brief    drain queued data of one shard in SHARD mode via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   idx             int ::= shard # (< 0: all shards, round-robin)
+ * @param    [out] *rbuf           void ::= read buffer
+ * @param    [in]   len             int ::= read buffer size
+ * @return          stat            int ::= # of bytes drained (< 0: error)
+ */
+int
+zndkcdev_shard_drain(int fd, int idx, void *rbuf, int len)
+{
+    int           stat = 0;
+    TZndkCdevMem  mem  = { rbuf, idx, len };
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_SHARD_DRAIN, &mem);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_export_dmabuf()
+ * @brief    export a range of the device buffer as a dma-buf via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   ofs             int ::= offset from top of driver buffer (page aligned)
+ * @param    [in]   len             int ::= length of the range (page aligned)
+ * @return          dmabuf_fd       int ::= dma-buf fd: mmap()able, passable over UNIX sockets (< 0: error)
+ */
+int
+zndkcdev_export_dmabuf(int fd, int ofs, int len)
+{
+    int           stat = 0;
+    TZndkCdevMem  mem  = { NULL, ofs, len };
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_EXPORT_DMABUF, &mem);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_checksum()
+ * @brief    checksum a range of the device buffer in the kernel via ioctl (no copy)
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   ofs             int ::= offset from top of driver buffer
+ * @param    [in]   len             int ::= length of the range
+ * @param    [in]   algo            int ::= ZNDKCDEV_CSUM_*
+ * @param    [in]   seed unsigned long long ::= CRC32C: CRC of the preceding data (0: none), XXH64: seed
+ * @param    [out] *csum unsigned long long ::= checksum
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_checksum(int fd, int ofs, int len, int algo, unsigned long long seed, unsigned long long *csum)
+{
+    int            stat = 0;
+    TZndkCdevCsum  req  = { ofs, len, algo, 0, seed, 0 };
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_CSUM, &req);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    } else {
+        *csum = req.csum;
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_fill()
+ * @brief    memset a range of the device buffer in the kernel via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   ofs             int ::= offset from top of driver buffer
+ * @param    [in]   len             int ::= length of the range
+ * @param    [in]   val             int ::= byte value
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_fill(int fd, int ofs, int len, int val)
+{
+    int            stat = 0;
+    TZndkCdevXfer  xf   = { ofs, 0, len, val, 0 };
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_FILL, &xf);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_move()
+ * @brief    memmove within the device buffer in the kernel via ioctl (ranges may overlap)
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   dst_ofs         int ::= destination offset
+ * @param    [in]   src_ofs         int ::= source offset
+ * @param    [in]   len             int ::= length [B]
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_move(int fd, int dst_ofs, int src_ofs, int len)
+{
+    int            stat = 0;
+    TZndkCdevXfer  xf   = { dst_ofs, src_ofs, len, 0, 0 };
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_MOVE, &xf);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_buf_copy()
+ * @brief    copy a range of another device's buffer into this one in the kernel via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor (destination)
+ * @param    [in]   dst_ofs         int ::= destination offset
+ * @param    [in]   src_minor       int ::= minor # of the source /dev/zndkcdev_<n>
+ * @param    [in]   src_ofs         int ::= source offset
+ * @param    [in]   len             int ::= length [B]
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_buf_copy(int fd, int dst_ofs, int src_minor, int src_ofs, int len)
+{
+    int            stat = 0;
+    TZndkCdevXfer  xf   = { dst_ofs, src_ofs, len, 0, src_minor };
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_BUF_COPY, &xf);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_flip()
+ * @brief    FLIP mode: publish the back frame as the new front via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *gen  unsigned long long ::= generation now visible (NULL: don't care)
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_flip(int fd, unsigned long long *gen)
+{
+    int     stat = 0;
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_FLIP, gen);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_flip_ctl_mmap()
+ * @brief    map the FLIP mode control page of a handle read-only (once)
+ *
+ * @param    [in]  *hdl      TDevHandle ::= handle
+ * @return         *ctl TZndkCdevFlipCtl ::= control page (NULL: error)
+ */
+const TZndkCdevFlipCtl *
+zndkcdev_flip_ctl_mmap(TDevHandle *hdl)
+{
+    void    *map;
+
+    if ((hdl == NULL) || (hdl->fd < 0)) {
+        return  NULL;
+    }
+
+    if (hdl->flip_ctl == NULL) {
+        map = hdl->be->mmap(hdl->fd, sysconf(_SC_PAGESIZE), ZNDKCDEV_FLIP_CTL_OFS, PROT_READ, 0);
+        if (map == MAP_FAILED) {
+            printf(" %s(): mapping error\n", __func__);
+            return  NULL;
+        }
+        hdl->flip_ctl = map;
+    }
+
+    return  hdl->flip_ctl;
+}
+
+/**
+ * zndkcdev_flip_front()
+ * @brief    FLIP mode: the front frame in the mapping of a handle, w/o copying
+ *
+ * @param    [in]  *hdl      TDevHandle ::= handle (zndkcdev_hdl_mmap()'ed)
+ * @param    [out] *gen  unsigned long long ::= generation of the frame, for zndkcdev_flip_valid()
+ * @return         *frame       uint8_t ::= front frame, ctl->len_frame [B] (NULL: error)
+ */
+const uint8_t *
+zndkcdev_flip_front(TDevHandle *hdl, unsigned long long *gen)
+{
+    const TZndkCdevFlipCtl *ctl = zndkcdev_flip_ctl_mmap(hdl);
+
+    if ((ctl == NULL) || (hdl->buf_virt == NULL)) {
+        return  NULL;
+    }
+    *gen = __atomic_load_n(&ctl->gen, __ATOMIC_ACQUIRE);
+
+    return  hdl->buf_virt + (*gen & 1) * ctl->len_frame;
+}
+
+/**
+ * zndkcdev_flip_valid()
+ * @brief    FLIP mode: did the frame of gen stay the front until now?
+ *           (1: everything read from it since zndkcdev_flip_front() is a complete frame,
+ *            0: flipped meanwhile, the producer may have overwritten it: read again)
+ *
+ * @param    [in]  *hdl      TDevHandle ::= handle
+ * @param    [in]   gen  unsigned long long ::= from zndkcdev_flip_front()
+ * @return          valid           int ::= 1: valid, 0: retry
+ */
+int
+zndkcdev_flip_valid(TDevHandle *hdl, unsigned long long gen)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE); /* frame loads before the re-check */
+
+    return  __atomic_load_n(&hdl->flip_ctl->gen, __ATOMIC_RELAXED) == gen;
+}
+
+/**
+ * zndkcdev_gen_start()
+ * @brief    start the in-kernel synthetic record producer via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   len_rec         int ::= record size [B] (multiple of 8, >= sizeof(TZndkCdevRec))
+ * @param    [in]   rate unsigned long long ::= target rate [B/s] (0: as fast as the mode takes)
+ * @param    [in]   period_us       int ::= timer period [us] (0: 100)
+ * @param    [in]   cpu             int ::= CPU to run the producer on (-1: any)
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_gen_start(int fd, int len_rec, unsigned long long rate, int period_us, int cpu)
+{
+    int            stat = 0;
+    TZndkCdevGen   gen  = { len_rec, period_us, cpu, 0, rate, 0, 0 };
+
+    printf(" %s(): ioctl: gen start (%d B, %llu B/s)\n", __func__, len_rec, rate);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GEN_START, &gen);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_gen_stop()
+ * @brief    stop the synthetic record producer via ioctl
+ *
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [out] *gen    TZndkCdevGen ::= parameters and final counters (NULL: don't care)
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_gen_stop(int fd, TZndkCdevGen *gen)
+{
+    int     stat = 0;
+
+    printf(" %s(): ioctl: gen stop\n", __func__);
+
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_GEN_STOP, gen);
+    if (stat < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_poll_create()
+ * @brief    create an epoll instance to multiplex zndkcdev fds
+ *
+ * @param    - none -
+ * @return          epfd            int ::= epoll file descriptor
+ */
+int
+zndkcdev_poll_create(void)
+{
+    int     epfd;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        printf(" %s(): error: epoll_create1 (%d)\n", __func__, epfd);
+    }
+
+    return  epfd;
+}
+
+/**
+ * zndkcdev_poll_add()
+ * @brief    watch a zndkcdev fd for readiness
+ *
+ * @param    [in]   epfd            int ::= epoll file descriptor
+ * @param    [in]   fd              int ::= file descriptor
+ * @param    [in]   events     uint32_t ::= EPOLLIN / EPOLLOUT / EPOLLET ...
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_poll_add(int epfd, int fd, uint32_t events)
+{
+    int                 stat = 0;
+    struct epoll_event  ev;
+
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events  = events;
+    ev.data.fd = fd;
+
+    stat = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    if (stat < 0) {
+        printf(" %s(): error: epoll_ctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_poll_del()
+ * @brief    stop watching a zndkcdev fd
+ *
+ * @param    [in]   epfd            int ::= epoll file descriptor
+ * @param    [in]   fd              int ::= file descriptor
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_poll_del(int epfd, int fd)
+{
+    int     stat = 0;
+
+    stat = epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    if (stat < 0) {
+        printf(" %s(): error: epoll_ctl (%d)\n", __func__, stat);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_poll_wait()
+ * @brief    wait until some of the watched zndkcdev fds get ready
+ *
+ * @param    [in]   epfd            int ::= epoll file descriptor
+ * @param    [out] *fds             int ::= ready file descriptors
+ * @param    [out] *revents    uint32_t ::= ready events of fds[]
+ * @param    [in]   max             int ::= # of entries of fds[]/revents[]
+ * @param    [in]   timeout_ms      int ::= timeout [ms] (-1: infinite)
+ * @return          n_ready         int ::= # of ready fds (< 0: error)
+ */
+int
+zndkcdev_poll_wait(int epfd, int *fds, uint32_t *revents, int max, int timeout_ms)
+{
+    struct epoll_event  evs[ZNDKCDEV_POLL_MAX];
+    int                 n_ready;
+    int                 idx;
+
+    if (max > ZNDKCDEV_POLL_MAX) {
+        max = ZNDKCDEV_POLL_MAX;
+    }
+
+    n_ready = epoll_wait(epfd, evs, max, timeout_ms);
+    if (n_ready < 0) {
+        printf(" %s(): error: epoll_wait (%d)\n", __func__, n_ready);
+        return  n_ready;
+    }
+
+    for (idx = 0; idx < n_ready; idx++) {
+        fds    [idx] = evs[idx].data.fd;
+        revents[idx] = evs[idx].events;
+    }
+
+    return  n_ready;
+}
+
 /**
  * zndkcdev_test()
  * @brief    test the zndkcdev driver via ioctl
@@ -354,7 +1409,7 @@ zndkcdev_test(int fd)
 
     printf(" %s(): ioctl: test\n", __func__);
 
-    stat = ioctl(fd, ZNDKCDEV_SIGNAL, NULL);
+    stat = _zndkcdev_ioctl(fd, ZNDKCDEV_SIGNAL, NULL);
     if (stat < 0) {
         printf(" %s(): error: ioctl (%d)\n", __func__, stat);
     }
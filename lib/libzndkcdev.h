@@ -17,32 +17,156 @@
 #ifndef    LIBZNDKCDEV_H
 #define    LIBZNDKCDEV_H
 
+#include <stdint.h>             /* uint8_t     */
+#include <sys/ioctl.h>          /* _IO()       */
+#include <sys/types.h>          /* pid_t       */
+
+#include "zndkcdev.h"           /* TZndkCdevMem */
+
+#ifdef   __cplusplus
+extern "C" {
+#endif
+
 /* definitions */
+#define  ZNDKCDEV_CTL_PATH             "/dev/" NAME_MODULE "_ctl" /* control device */
+#define  ZNDKCDEV_POLL_MAX             64 /* max # of fds per zndkcdev_poll_wait() */
+
+typedef int (* TSigCallback)(int signum, int dat);
+
+/**
+ * @struct TZndkCdevBackend
+ * @brief  transport under the libzndkcdev API (zndkcdev_set_backend())
+ *
+ * @note   ioctl() takes the ZNDKCDEV_* commands of zndkcdev.h and returns
+ *         like ioctl(2): >= 0 on success, -1 w/ errno set on error
+ */
+typedef struct {
+    const char *name;                                          /* "dev", "shm", ...      */
+    int      (* open  )(const char *path, int flags);          /* -> fd                  */
+    int      (* close )(int fd);
+    int      (* ioctl )(int fd, unsigned long cmd, void *arg); /* ZNDKCDEV_* commands    */
+    void    *(* mmap  )(int fd, size_t len, off_t ofs, int prot, int flags); /* MAP_SHARED | flags, MAP_FAILED on error */
+    int      (* munmap)(int fd, void *map, size_t len);
+} TZndkCdevBackend;
+
+#define  ZNDKCDEV_BACKEND_ENV          "ZNDKCDEV_BACKEND" /* "dev" (default) or "shm" */
+
+extern const TZndkCdevBackend  zndkcdev_backend_dev; /* /dev/zndkcdev_<n> (kernel module)   */
+extern const TZndkCdevBackend  zndkcdev_backend_shm; /* POSIX shm emulation (no module)     */
 
 /**
  * @struct TDevHandle
- * @brief  ZndkCdev handle info
+ * @brief  ZndkCdev handle info: one per open device, allocated by
+ *         zndkcdev_hdl_open() and freed by zndkcdev_hdl_close()
  */
 typedef struct {
     int      fd;                /* file descriptor                             */
 
     uint8_t *buf_virt;          /* driver managed buffer (virt)                */
     int      len_buf;           /* lenght of driver managed buffer (unit: [B]) */
+
+    const TZndkCdevBackend *be; /* transport the fd was opened through         */
+
+    const TZndkCdevFlipCtl *flip_ctl; /* FLIP mode control page (read-only map) */
 } TDevHandle;
 
-typedef int (* TSigCallback)(int signum, int dat);
+/**
+ * @struct TZndkCdevWindow
+ * @brief  mapping of a page aligned slice of a device buffer (zndkcdev_hdl_mmap_window())
+ */
+typedef struct {
+    TDevHandle *hdl;            /* device the window belongs to                */
+    uint8_t    *map;            /* = buffer + ofs                              */
+    int         ofs;            /* offset in the buffer (page aligned) [B]     */
+    int         len;            /* length of the window [B]                    */
+} TZndkCdevWindow;
+
+/* asynchronous API on io_uring (libzndkcdev_uring.c) */
+typedef struct TZndkCdevUring TZndkCdevUring;                 /* opaque ring         */
+typedef void (* TZndkCdevUringCb)(void *user, int res);       /* res: like the syscall's return, -errno on error */
+
+/* command queue w/ optional kernel polling thread (libzndkcdev_cmdq.c) */
+typedef struct TZndkCdevCmdq TZndkCdevCmdq;                   /* opaque queue        */
+typedef void (* TZndkCdevCmdqCb)(void *user, int res, unsigned long long val); /* res: 0 or -errno, val: checksum */
+
+struct iovec;
 
 /* extern declarations */
+extern  int            zndkcdev_set_backend(const TZndkCdevBackend *be);
+extern const TZndkCdevBackend *zndkcdev_get_backend(void);
+extern TDevHandle *    zndkcdev_hdl_open   (const char *filepath);
+extern  int            zndkcdev_hdl_close  (TDevHandle *hdl);
+extern TDevHandle *    zndkcdev_hdl_get    (int fd);
+extern uint8_t *       zndkcdev_hdl_mmap   (TDevHandle *hdl);
+extern  int            zndkcdev_hdl_munmap (TDevHandle *hdl);
+extern TZndkCdevWindow *zndkcdev_hdl_mmap_window  (TDevHandle *hdl, int ofs, int len);
+extern  int            zndkcdev_hdl_munmap_window(TZndkCdevWindow *win);
 extern  int            zndkcdev_open       (const char *filepaht);
 extern  int            zndkcdev_close      (int fd);
+extern  int            zndkcdev_ctl_open   (void);
+extern  int            zndkcdev_ctl_close  (int ctl_fd);
+extern  int            zndkcdev_dev_create (int ctl_fd, int minor, int len_buf);
+extern  int            zndkcdev_dev_destroy(int ctl_fd, int minor);
 extern uint8_t *       zndkcdev_mmap       (int fd);
 extern  int            zndkcdev_munmap     (int fd);
+extern  int            zndkcdev_set_mmap_mode(int fd, int mode);
+extern  int            zndkcdev_buf_sync   (int fd, int   ofs, int len);
 extern  int            zndkcdev_get_version(int fd, char *ver);
+extern  int            zndkcdev_get_feature(int fd, TZndkCdevFeature *feat);
+extern  int            zndkcdev_get_stats  (int fd, TZndkCdevStats *stats);
+extern  int            zndkcdev_get_buf_len(int fd, int  *len);
+extern  int            zndkcdev_buf_resize (int fd, int   len);
 extern  int            zndkcdev_buf_read   (int fd, int   ofs, int len, const void *rbuf);
 extern  int            zndkcdev_buf_write  (int fd, int   ofs, int len,       void *wbuf);
+extern  int            zndkcdev_buf_readv  (int fd, TZndkCdevMem *mem, int *stat, int n_mem);
+extern  int            zndkcdev_buf_writev (int fd, TZndkCdevMem *mem, int *stat, int n_mem);
 extern  int            zndkcdev_print      (int fd, const char *msg);
 extern  int            zndkcdev_send_signal(int fd, TSigCallback sigcb, pid_t pid, int dat);
+extern  int            zndkcdev_set_mode   (int fd, int   mode);
+extern  int            zndkcdev_get_mode   (int fd, int  *mode);
+extern  int            zndkcdev_shard_drain(int fd, int   idx, void *rbuf, int len);
+extern  int            zndkcdev_export_dmabuf(int fd, int ofs, int len);
+extern  int            zndkcdev_buf_checksum(int fd, int ofs, int len, int algo, unsigned long long seed, unsigned long long *csum);
+extern  int            zndkcdev_buf_fill   (int fd, int   ofs, int len, int val);
+extern  int            zndkcdev_buf_move   (int fd, int   dst_ofs, int src_ofs, int len);
+extern  int            zndkcdev_buf_copy   (int fd, int   dst_ofs, int src_minor, int src_ofs, int len);
+extern  int            zndkcdev_flip       (int fd, unsigned long long *gen);
+extern const TZndkCdevFlipCtl *zndkcdev_flip_ctl_mmap(TDevHandle *hdl);
+extern const uint8_t * zndkcdev_flip_front (TDevHandle *hdl, unsigned long long *gen);
+extern  int            zndkcdev_flip_valid (TDevHandle *hdl, unsigned long long  gen);
+extern  int            zndkcdev_gen_start  (int fd, int   len_rec, unsigned long long rate, int period_us, int cpu);
+extern  int            zndkcdev_gen_stop   (int fd, TZndkCdevGen *gen);
+extern  int            zndkcdev_poll_create(void);
+extern  int            zndkcdev_poll_add   (int epfd, int fd, uint32_t events);
+extern  int            zndkcdev_poll_del   (int epfd, int fd);
+extern  int            zndkcdev_poll_wait  (int epfd, int *fds, uint32_t *revents, int max, int timeout_ms);
 extern  int            zndkcdev_test       (int fd);
 
+extern TZndkCdevUring *zndkcdev_uring_create (unsigned depth);
+extern  int            zndkcdev_uring_destroy(TZndkCdevUring *ur);
+extern  int            zndkcdev_uring_register_buffers(TZndkCdevUring *ur, const struct iovec *iov, int n_iov);
+extern  int            zndkcdev_uring_read   (TZndkCdevUring *ur, int fd,       void *buf, unsigned len, uint64_t off, TZndkCdevUringCb cb, void *user);
+extern  int            zndkcdev_uring_write  (TZndkCdevUring *ur, int fd, const void *buf, unsigned len, uint64_t off, TZndkCdevUringCb cb, void *user);
+extern  int            zndkcdev_uring_read_fixed (TZndkCdevUring *ur, int fd, int buf_idx,       void *buf, unsigned len, uint64_t off, TZndkCdevUringCb cb, void *user);
+extern  int            zndkcdev_uring_write_fixed(TZndkCdevUring *ur, int fd, int buf_idx, const void *buf, unsigned len, uint64_t off, TZndkCdevUringCb cb, void *user);
+extern  int            zndkcdev_uring_buf_read (TZndkCdevUring *ur, int fd, int ofs, int len,       void *rbuf, TZndkCdevUringCb cb, void *user);
+extern  int            zndkcdev_uring_buf_write(TZndkCdevUring *ur, int fd, int ofs, int len, const void *wbuf, TZndkCdevUringCb cb, void *user);
+extern  int            zndkcdev_uring_submit (TZndkCdevUring *ur);
+extern  int            zndkcdev_uring_wait   (TZndkCdevUring *ur, unsigned min_complete);
+
+extern TZndkCdevCmdq * zndkcdev_cmdq_create (int fd, unsigned entries, int sq_cpu, int sq_idle_ms);
+extern  int            zndkcdev_cmdq_destroy(TZndkCdevCmdq *q);
+extern  int            zndkcdev_cmdq_buf_read (TZndkCdevCmdq *q, int ofs, int len,       void *rbuf, TZndkCdevCmdqCb cb, void *user);
+extern  int            zndkcdev_cmdq_buf_write(TZndkCdevCmdq *q, int ofs, int len, const void *wbuf, TZndkCdevCmdqCb cb, void *user);
+extern  int            zndkcdev_cmdq_buf_fill (TZndkCdevCmdq *q, int ofs, int len, int val, TZndkCdevCmdqCb cb, void *user);
+extern  int            zndkcdev_cmdq_buf_checksum(TZndkCdevCmdq *q, int ofs, int len, int algo, unsigned long long seed, TZndkCdevCmdqCb cb, void *user);
+extern  int            zndkcdev_cmdq_notify (TZndkCdevCmdq *q, pid_t pid, int dat, TZndkCdevCmdqCb cb, void *user);
+extern  int            zndkcdev_cmdq_submit (TZndkCdevCmdq *q);
+extern  int            zndkcdev_cmdq_wait   (TZndkCdevCmdq *q, unsigned min_complete);
+
+#ifdef   __cplusplus
+}
+#endif
+
 #endif  /* LIBZNDKCDEV_H */
 /* end */
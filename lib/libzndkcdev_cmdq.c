@@ -0,0 +1,337 @@
+/**
+ * @file     libzndkcdev_cmdq.c
+ * @brief    libzndkcdev command queue: batched commands w/o an ioctl each
+ *
+ * @note     the SQ/CQ pair of a device fd lives in a region mmap'ed from the
+ *           driver (ZNDKCDEV_CMDQ_SETUP, ZNDKCDEV_CMDQ_OFS):
+ *           zndkcdev_cmdq_(buf_read|buf_write|buf_fill|buf_checksum|notify)() queue
+ *           commands, zndkcdev_cmdq_submit() publishes them and rings the doorbell
+ *           (ZNDKCDEV_CMDQ_ENTER) once per batch, zndkcdev_cmdq_wait() runs the
+ *           completion callbacks. w/ a polling thread (sq_cpu >= 0) the doorbell
+ *           is only rung while the thread sleeps: steady-state submission and
+ *           completion take no syscall at all.
+ *
+ * @note     one queue per open fd (the driver frees it on close); a queue is
+ *           not thread-safe: use one fd per thread
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#include <errno.h>              /* errno       */
+#include <sched.h>              /* sched_yield() */
+#include <stdio.h>              /* printf()    */
+#include <stdlib.h>             /* calloc()    */
+#include <string.h>             /* memset()    */
+#include <sys/mman.h>           /* PROT_*      */
+
+#include    "zndkcdev.h"        /* zndk driver */
+#include "libzndkcdev.h"        /* zndk lib    */
+
+/**
+ * @struct TZndkCdevCmdqReq
+ * @brief  completion of one command (slot # = user_data)
+ */
+typedef struct {
+    TZndkCdevCmdqCb   cb;       /* NULL: free slot                   */
+    void             *user;     /* passed to cb()                    */
+} TZndkCdevCmdqReq;
+
+/**
+ * @struct TZndkCdevCmdq
+ * @brief  command queue of one device fd w/ its mapped region
+ */
+struct TZndkCdevCmdq {
+    TDevHandle           *hdl;      /* device the queue belongs to       */
+    int                   sq_cpu;   /* CPU of the polling thread (-1: none) */
+
+    TZndkCdevCmdqHdr     *hdr;      /* region mapping                    */
+    size_t                len;
+    TZndkCdevSqe         *sqes;
+    TZndkCdevCqe         *cqes;
+    unsigned              sq_entries;
+    unsigned              sq_local; /* tail incl. not yet published SQEs */
+
+    TZndkCdevCmdqReq     *req;      /* [n_req]                           */
+    unsigned             *free;     /* stack of free slots               */
+    unsigned              n_req;    /* = CQ entries: bounds the in-flight count */
+    unsigned              n_free;
+};
+
+/**
+ * _cmdq_cb_nop()
+ * @brief    completion callback of commands queued w/o one
+ */
+static void
+_cmdq_cb_nop(void *user, int res, unsigned long long val)
+{
+    (void)user;
+    (void)res;
+    (void)val;
+}
+
+/**
+ * _cmdq_push()
+ * @brief    fill the next SQE and take a completion slot
+ * @return   0, -1 w/ errno = EBUSY: queue full, reap first
+ */
+static int
+_cmdq_push(TZndkCdevCmdq *q, int op, int ofs, int len, unsigned long long addr, int val,
+           TZndkCdevCmdqCb cb, void *user)
+{
+    TZndkCdevSqe *sqe;
+    unsigned      head = __atomic_load_n(&q->hdr->sq_head, __ATOMIC_ACQUIRE);
+    unsigned      slot;
+
+    if (((q->sq_local - head) >= q->sq_entries) || (q->n_free == 0)) {
+        errno = EBUSY;
+        return  -1;
+    }
+
+    slot               = q->free[--q->n_free];
+    q->req[slot].cb    = (cb != NULL) ? cb : _cmdq_cb_nop;
+    q->req[slot].user  = user;
+
+    sqe                = &q->sqes[q->sq_local & (q->sq_entries - 1)];
+    sqe->user_data     = slot;
+    sqe->addr          = addr;
+    sqe->op            = op;
+    sqe->ofs           = ofs;
+    sqe->len           = len;
+    sqe->val           = val;
+    q->sq_local++;
+
+    return  0;
+}
+
+/**
+ * zndkcdev_cmdq_create()
+ * @brief    create the command queue of a device fd and map it
+ *
+ * @param    [in]   fd              int ::= file descriptor of /dev/zndkcdev_<n> (zndkcdev_open())
+ * @param    [in]   entries    unsigned ::= # of SQ entries (in-flight up to 2x)
+ * @param    [in]   sq_cpu          int ::= CPU to run the polling thread on (-1: none, doorbell per batch)
+ * @param    [in]   sq_idle_ms      int ::= poller: idle time before it sleeps (0: driver default)
+ * @return         *q     TZndkCdevCmdq ::= queue (NULL: error)
+ */
+TZndkCdevCmdq *
+zndkcdev_cmdq_create(int fd, unsigned entries, int sq_cpu, int sq_idle_ms)
+{
+    TDevHandle          *hdl   = zndkcdev_hdl_get(fd);
+    TZndkCdevCmdqSetup   setup = { (int)entries, 0, sq_cpu, sq_idle_ms, 0 };
+    TZndkCdevCmdq       *q;
+    void                *map;
+    unsigned             i;
+
+    if ((hdl == NULL) || (hdl->be == NULL)) {
+        errno = EBADF;
+        return  NULL;
+    }
+    if (hdl->be->ioctl(fd, ZNDKCDEV_CMDQ_SETUP, &setup) < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, errno);
+        return  NULL;
+    }
+
+    q = calloc(1, sizeof(TZndkCdevCmdq));
+    if (q == NULL) {
+        return  NULL;
+    }
+    map = hdl->be->mmap(fd, setup.len, ZNDKCDEV_CMDQ_OFS, PROT_READ | PROT_WRITE, MAP_POPULATE);
+    if (map == MAP_FAILED) {
+        printf(" %s(): error: mmap (%d)\n", __func__, errno);
+        free(q);
+        return  NULL;
+    }
+
+    q->hdl        = hdl;
+    q->sq_cpu     = sq_cpu;
+    q->hdr        = map;
+    q->len        = setup.len;
+    q->sqes       = (TZndkCdevSqe *)((char *)map + q->hdr->sq_ofs);
+    q->cqes       = (TZndkCdevCqe *)((char *)map + q->hdr->cq_ofs);
+    q->sq_entries = setup.sq_entries;
+    q->sq_local   = q->hdr->sq_tail;
+
+    /* one slot per CQ entry: the driver never stalls on a full CQ */
+    q->n_req      = setup.cq_entries;
+    q->req        = calloc(q->n_req, sizeof(TZndkCdevCmdqReq));
+    q->free       = calloc(q->n_req, sizeof(unsigned));
+    if ((q->req == NULL) || (q->free == NULL)) {
+        zndkcdev_cmdq_destroy(q);
+        return  NULL;
+    }
+    for (i = 0; i < q->n_req; i++) {
+        q->free[i] = q->n_req - 1 - i;
+    }
+    q->n_free     = q->n_req;
+
+    return  q;
+}
+
+/**
+ * zndkcdev_cmdq_destroy()
+ * @brief    unmap a queue (the driver keeps it, and its poller, until the fd is closed)
+ *
+ * @param    [in]  *q     TZndkCdevCmdq ::= queue
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_cmdq_destroy(TZndkCdevCmdq *q)
+{
+    if (q == NULL) {
+        return  -1;
+    }
+
+    q->hdl->be->munmap(q->hdl->fd, q->hdr, q->len);
+    free(q->req);
+    free(q->free);
+    free(q);
+
+    return  0;
+}
+
+/**
+ * zndkcdev_cmdq_buf_read()
+ * @brief    queue ZNDKCDEV_OP_BUF_RD: same as zndkcdev_buf_read(), batched
+ *
+ * @param    [in]  *q     TZndkCdevCmdq ::= queue
+ * @param    [in]   ofs             int ::= offset from top of driver buffer
+ * @param    [in]   len             int ::= length to be read
+ * @param    [out] *rbuf           void ::= read buffer
+ * @param    [in]   cb   TZndkCdevCmdqCb ::= completion callback (NULL: none)
+ * @param    [in]  *user           void ::= passed to cb()
+ * @return          stat            int ::= process status (-1 w/ EBUSY: queue full, reap first)
+ */
+int
+zndkcdev_cmdq_buf_read(TZndkCdevCmdq *q, int ofs, int len, void *rbuf, TZndkCdevCmdqCb cb, void *user)
+{
+    return  _cmdq_push(q, ZNDKCDEV_OP_BUF_RD, ofs, len, (uintptr_t)rbuf, 0, cb, user);
+}
+
+/**
+ * zndkcdev_cmdq_buf_write()
+ * @brief    queue ZNDKCDEV_OP_BUF_WR: same as zndkcdev_buf_write(), batched
+ */
+int
+zndkcdev_cmdq_buf_write(TZndkCdevCmdq *q, int ofs, int len, const void *wbuf, TZndkCdevCmdqCb cb, void *user)
+{
+    return  _cmdq_push(q, ZNDKCDEV_OP_BUF_WR, ofs, len, (uintptr_t)wbuf, 0, cb, user);
+}
+
+/**
+ * zndkcdev_cmdq_buf_fill()
+ * @brief    queue ZNDKCDEV_OP_BUF_FILL: same as zndkcdev_buf_fill(), batched
+ */
+int
+zndkcdev_cmdq_buf_fill(TZndkCdevCmdq *q, int ofs, int len, int val, TZndkCdevCmdqCb cb, void *user)
+{
+    return  _cmdq_push(q, ZNDKCDEV_OP_BUF_FILL, ofs, len, 0, val, cb, user);
+}
+
+/**
+ * zndkcdev_cmdq_buf_checksum()
+ * @brief    queue ZNDKCDEV_OP_BUF_CSUM: same as zndkcdev_buf_checksum(), the checksum
+ *           is passed to cb() as val
+ */
+int
+zndkcdev_cmdq_buf_checksum(TZndkCdevCmdq *q, int ofs, int len, int algo, unsigned long long seed,
+                           TZndkCdevCmdqCb cb, void *user)
+{
+    return  _cmdq_push(q, ZNDKCDEV_OP_BUF_CSUM, ofs, len, seed, algo, cb, user);
+}
+
+/**
+ * zndkcdev_cmdq_notify()
+ * @brief    queue ZNDKCDEV_OP_NOTIFY: SIGUSR1 w/ si_int = dat to pid, as zndkcdev_send_signal()
+ *           (the signal handler has to be installed by the caller)
+ */
+int
+zndkcdev_cmdq_notify(TZndkCdevCmdq *q, pid_t pid, int dat, TZndkCdevCmdqCb cb, void *user)
+{
+    return  _cmdq_push(q, ZNDKCDEV_OP_NOTIFY, 0, 0, (unsigned long long)pid, dat, cb, user);
+}
+
+/**
+ * zndkcdev_cmdq_submit()
+ * @brief    publish the queued commands; ring the doorbell unless the poller is awake
+ *
+ * @param    [in]  *q     TZndkCdevCmdq ::= queue
+ * @return          n_sub           int ::= # of commands published (< 0: error)
+ */
+int
+zndkcdev_cmdq_submit(TZndkCdevCmdq *q)
+{
+    unsigned  n_new = q->sq_local - q->hdr->sq_tail;
+
+    if (n_new == 0) {
+        return  0;
+    }
+    __atomic_store_n(&q->hdr->sq_tail, q->sq_local, __ATOMIC_RELEASE);
+
+    if (q->sq_cpu >= 0) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); /* sq_tail, then flags: pairs w/ the poller */
+        if (!(__atomic_load_n(&q->hdr->flags, __ATOMIC_RELAXED) & ZNDKCDEV_CMDQ_NEED_WAKEUP)) {
+            return  (int)n_new;
+        }
+    }
+    if (q->hdl->be->ioctl(q->hdl->fd, ZNDKCDEV_CMDQ_ENTER, NULL) < 0) {
+        printf(" %s(): error: ioctl (%d)\n", __func__, errno);
+        return  -1;
+    }
+
+    return  (int)n_new;
+}
+
+/**
+ * zndkcdev_cmdq_wait()
+ * @brief    submit what is queued, reap min_complete completions and run their callbacks
+ *           (w/ a poller: spins, yielding the CPU, until they are posted)
+ *
+ * @param    [in]  *q     TZndkCdevCmdq ::= queue
+ * @param    [in]   min_complete unsigned ::= # of completions to wait for (0: just reap)
+ * @return          n_cqe           int ::= # of completions reaped (< 0: error)
+ */
+int
+zndkcdev_cmdq_wait(TZndkCdevCmdq *q, unsigned min_complete)
+{
+    TZndkCdevCqe     *cqe;
+    TZndkCdevCmdqReq  req;
+    unsigned          head;
+    unsigned          tail;
+    unsigned          n_cqe = 0;
+
+    if (zndkcdev_cmdq_submit(q) < 0) {
+        return  -1;
+    }
+
+    for (;;) {
+        head = q->hdr->cq_head;
+        tail = __atomic_load_n(&q->hdr->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++, n_cqe++) {
+            cqe = &q->cqes[head & q->hdr->cq_mask];
+            req = q->req[cqe->user_data];
+
+            q->req[cqe->user_data].cb = NULL;
+            q->free[q->n_free++]      = (unsigned)cqe->user_data;
+            __atomic_store_n(&q->hdr->cq_head, head + 1, __ATOMIC_RELEASE); /* callback may queue again */
+
+            req.cb(req.user, cqe->res, cqe->val);
+        }
+
+        if ((n_cqe >= min_complete) || (q->n_free == q->n_req)) {
+            break;              /* done, or nothing left in flight */
+        }
+        if (q->sq_cpu >= 0) {
+            sched_yield();
+        } else if (q->hdl->be->ioctl(q->hdl->fd, ZNDKCDEV_CMDQ_ENTER, NULL) < 0) {
+            printf(" %s(): error: ioctl (%d)\n", __func__, errno);
+            return  -1;
+        }
+    }
+
+    return  (int)n_cqe;
+}
+
+/* end */
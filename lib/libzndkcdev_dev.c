@@ -0,0 +1,76 @@
+/**
+ * @file     libzndkcdev_dev.c
+ * @brief    libzndkcdev backend: the zndkcdev kernel module (/dev/zndkcdev_<n>)
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#include <fcntl.h>              /* open()      */
+#include <unistd.h>             /* close()     */
+#include <sys/ioctl.h>          /* ioctl()     */
+#include <sys/mman.h>           /* mmap()      */
+
+#include    "zndkcdev.h"        /* zndk driver */
+#include "libzndkcdev.h"        /* zndk lib    */
+
+/**
+ * _dev_open()
+ */
+static int
+_dev_open(const char *path, int flags)
+{
+    return  open(path, flags);
+}
+
+/**
+ * _dev_close()
+ */
+static int
+_dev_close(int fd)
+{
+    return  close(fd);
+}
+
+/**
+ * _dev_ioctl()
+ */
+static int
+_dev_ioctl(int fd, unsigned long cmd, void *arg)
+{
+    return  ioctl(fd, cmd, arg);
+}
+
+/**
+ * _dev_mmap()
+ */
+static void *
+_dev_mmap(int fd, size_t len, off_t ofs, int prot, int flags)
+{
+    return  mmap(NULL, len, prot, MAP_SHARED | flags, fd, ofs);
+}
+
+/**
+ * _dev_munmap()
+ */
+static int
+_dev_munmap(int fd, void *map, size_t len)
+{
+    return  munmap(map, len);
+}
+
+/**
+ * zndkcdev_backend_dev
+ */
+const TZndkCdevBackend  zndkcdev_backend_dev = {
+    .name   = "dev"      ,
+    .open   = _dev_open  ,
+    .close  = _dev_close ,
+    .ioctl  = _dev_ioctl ,
+    .mmap   = _dev_mmap  ,
+    .munmap = _dev_munmap,
+};
+
+/* end */
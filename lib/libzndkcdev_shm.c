@@ -0,0 +1,598 @@
+/**
+ * @file     libzndkcdev_shm.c
+ * @brief    libzndkcdev backend: the zndkcdev device emulated in POSIX shared memory
+ *
+ * @note     /dev/zndkcdev_<n> is emulated by the shm object /zndkcdev_<n>
+ *           (/dev/shm/zndkcdev_<n>), so co-located processes share the buffer
+ *           w/o the kernel module and w/o a syscall per BUF_RD/BUF_WR:
+ *
+ *           offset 0       : buffer (len_buf [B]): read/pread/mmap work as on the device
+ *           offset len_buf : TShmHdr (1 page)
+ *
+ * @note     a resize rebuilds the object under flock(LOCK_EX); openers attach and
+ *           count themselves under LOCK_SH, so none sees it half-built
+ *
+ * @note     only the flat mode is emulated; FIFO/SHARD mode, ZNDKCDEV_GET_STATS and
+ *           poll/epoll need the kernel module
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#include <errno.h>              /* errno       */
+#include <fcntl.h>              /* O_CREAT     */
+#include <pthread.h>            /* pthread_rwlock_*() */
+#include <signal.h>             /* sigqueue()  */
+#include <stdio.h>              /* printf()    */
+#include <stdint.h>             /* uint32_t    */
+#include <stdlib.h>             /* calloc()    */
+#include <string.h>             /* memcpy()    */
+#include <unistd.h>             /* ftruncate() */
+#include <sys/file.h>           /* flock()     */
+#include <sys/mman.h>           /* shm_open()  */
+#include <sys/stat.h>           /* fstat()     */
+#include <sys/types.h>          /* pid_t       */
+
+#include    "zndkcdev.h"        /* zndk driver */
+#include "libzndkcdev.h"        /* zndk lib    */
+
+/* definitions */
+#define  SHM_MAGIC             0x4b444e5a /* "ZNDK": header is initialised */
+#define  SHM_FDMAP_BITS                10 /* fds per chunk: 1 << 10        */
+#define  SHM_FDMAP_N                 4096 /* chunks: fds < 4 Mi            */
+#define  SHM_LEN_HDR                 4096 /* header page                   */
+#define  SHM_CTL_NAME    "/" NAME_MODULE "_ctl" /* emulated w/o a shm object */
+#define  SHM_WAIT_MS                 1000 /* wait for a concurrent creator */
+
+/**
+ * @struct TShmHdr
+ * @brief  device state shared by all openers (tail page of the shm object)
+ */
+typedef struct {
+    volatile uint32_t magic;    /* SHM_MAGIC once initialised          */
+    int               len_buf;  /* buffer size [B]                     */
+    int               n_open;   /* # of open fds  (all processes)      */
+    int               n_mmap;   /* # of mappings  (all processes)      */
+    pthread_rwlock_t  lock;     /* BUF_RD: shared, BUF_WR/resize: excl */
+} TShmHdr;
+
+/**
+ * @struct TShmFile
+ * @brief  per-fd state of this process
+ */
+typedef struct {
+    TShmHdr  *hdr;              /* mapped header (NULL: not ours)      */
+    uint8_t  *buf;              /* mapped buffer                       */
+    int       len_buf;          /* length of the mapping above         */
+    int       is_ctl;           /* /dev/zndkcdev_ctl                   */
+} TShmFile;
+static TShmFile        *ShmFile[SHM_FDMAP_N]; /* sparse: chunks allocated on first use */
+static pthread_mutex_t  ShmFileMtx = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * _get_shm_file()
+ * @brief    per-fd state (NULL: fd out of range / out of memory)
+ */
+static TShmFile *
+_get_shm_file(int fd)
+{
+    TShmFile *chunk;
+
+    if ((fd < 0) || ((fd >> SHM_FDMAP_BITS) >= SHM_FDMAP_N)) {
+        return  NULL;
+    }
+    chunk = __atomic_load_n(&ShmFile[fd >> SHM_FDMAP_BITS], __ATOMIC_ACQUIRE);
+    if (chunk == NULL) {
+        pthread_mutex_lock(&ShmFileMtx);
+        chunk = ShmFile[fd >> SHM_FDMAP_BITS];
+        if (chunk == NULL) {
+            chunk = calloc(1 << SHM_FDMAP_BITS, sizeof(TShmFile));
+            __atomic_store_n(&ShmFile[fd >> SHM_FDMAP_BITS], chunk, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&ShmFileMtx);
+    }
+
+    return  (chunk != NULL) ? &chunk[fd & ((1 << SHM_FDMAP_BITS) - 1)] : NULL;
+}
+
+/**
+ * _shm_name()
+ * @brief    "/dev/zndkcdev_3" -> "/zndkcdev_3"
+ */
+static int
+_shm_name(const char *path, char *name, size_t len)
+{
+    const char *base = strrchr(path, '/');
+
+    base = (base != NULL) ? base + 1 : path;
+    if (strncmp(base, NAME_MODULE "_", strlen(NAME_MODULE "_")) != 0) {
+        errno = ENOENT;
+        return  -1;
+    }
+    snprintf(name, len, "/%s", base);
+
+    return  0;
+}
+
+/**
+ * _shm_init()
+ * @brief    size a freshly created object and initialise its header
+ */
+static int
+_shm_init(int fd, int len_buf)
+{
+    pthread_rwlockattr_t  attr;
+    TShmHdr              *hdr;
+
+    len_buf = (len_buf + SHM_LEN_HDR - 1) & ~(SHM_LEN_HDR - 1); /* page aligned, as the driver */
+    if (ftruncate(fd, (off_t)len_buf + SHM_LEN_HDR) < 0) {
+        return  -1;
+    }
+    hdr = mmap(NULL, SHM_LEN_HDR, PROT_READ | PROT_WRITE, MAP_SHARED, fd, len_buf);
+    if (hdr == MAP_FAILED) {
+        return  -1;
+    }
+
+    hdr->len_buf = len_buf;
+    hdr->n_open  = 0;
+    hdr->n_mmap  = 0;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_rwlock_init(&hdr->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    __atomic_store_n(&hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE); /* publish */
+
+    munmap(hdr, SHM_LEN_HDR);
+
+    return  0;
+}
+
+/**
+ * _shm_create()
+ * @brief    create /zndkcdev_<minor> (ZNDKCDEV_CTL_CREATE)
+ * @return   0: created, -1 w/ errno (EEXIST: minor in use)
+ */
+static int
+_shm_create(int minor, int len_buf)
+{
+    char      name[64];
+    int       fd;
+    int       stat;
+
+    snprintf(name, sizeof(name), "/%s_%d", NAME_MODULE, minor);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return  -1;
+    }
+    stat = _shm_init(fd, (len_buf != 0) ? len_buf : LEN_ZNDKCDEV_BUF);
+    if (stat < 0) {
+        shm_unlink(name);
+    }
+    close(fd);
+
+    return  stat;
+}
+
+/**
+ * _shm_attach()
+ * @brief    map the header and the buffer of an opened object
+ */
+static int
+_shm_attach(int fd, TShmFile *sf)
+{
+    struct stat  st;
+    TShmHdr     *hdr;
+    int          ms;
+
+    for (ms = 0; ms < SHM_WAIT_MS; ms++) { /* a concurrent creator may still be sizing it */
+        if (fstat(fd, &st) < 0) {
+            return  -1;
+        }
+        if (st.st_size > SHM_LEN_HDR) {
+            hdr = mmap(NULL, SHM_LEN_HDR, PROT_READ | PROT_WRITE, MAP_SHARED, fd, st.st_size - SHM_LEN_HDR);
+            if (hdr == MAP_FAILED) {
+                return  -1;
+            }
+            if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SHM_MAGIC) {
+                sf->hdr     = hdr;
+                sf->len_buf = hdr->len_buf;
+                sf->buf     = mmap(NULL, sf->len_buf, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (sf->buf == MAP_FAILED) {
+                    munmap(hdr, SHM_LEN_HDR);
+                    sf->hdr = NULL;
+                    return  -1;
+                }
+                return  0;
+            }
+            munmap(hdr, SHM_LEN_HDR);
+        }
+        usleep(1000);
+    }
+    errno = ETIMEDOUT;
+
+    return  -1;
+}
+
+/**
+ * _shm_detach()
+ */
+static void
+_shm_detach(TShmFile *sf)
+{
+    if (sf->buf != NULL) {
+        munmap(sf->buf, sf->len_buf);
+    }
+    if (sf->hdr != NULL) {
+        munmap(sf->hdr, SHM_LEN_HDR);
+    }
+    memset(sf, 0, sizeof(TShmFile));
+}
+
+/**
+ * _shm_open()
+ * @brief    open /zndkcdev_<n>, created on first use w/ the default buffer size
+ */
+static int
+_shm_open(const char *path, int flags)
+{
+    char      name[64];
+    TShmFile *sf;
+    int       fd;
+
+    if (_shm_name(path, name, sizeof(name)) < 0) {
+        return  -1;
+    }
+
+    if (strcmp(name, SHM_CTL_NAME) == 0) {
+        fd = open("/dev/null", O_RDWR | (flags & O_CLOEXEC)); /* only a handle for the ioctls */
+        sf = _get_shm_file(fd);
+        if ((fd >= 0) && (sf == NULL)) {
+            close(fd);
+            errno = EMFILE;
+            return  -1;
+        }
+        if (sf != NULL) {
+            sf->is_ctl = 1;
+        }
+        return  fd;
+    }
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600); /* always close-on-exec */
+    if (fd >= 0) {
+        if (_shm_init(fd, LEN_ZNDKCDEV_BUF) < 0) {
+            close(fd);
+            shm_unlink(name);
+            return  -1;
+        }
+    } else if (errno == EEXIST) {
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        return  -1;
+    }
+
+    sf = _get_shm_file(fd);
+    if (sf == NULL) {
+        close(fd);
+        errno = EMFILE;
+        return  -1;
+    }
+    flock(fd, LOCK_SH);         /* waits out a _shm_resize() in progress */
+    if (_shm_attach(fd, sf) < 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return  -1;
+    }
+    __atomic_add_fetch(&sf->hdr->n_open, 1, __ATOMIC_RELAXED);
+    flock(fd, LOCK_UN);
+
+    return  fd;
+}
+
+/**
+ * _shm_close()
+ */
+static int
+_shm_close(int fd)
+{
+    TShmFile *sf = _get_shm_file(fd);
+
+    if ((sf != NULL) && (sf->hdr != NULL)) {
+        __atomic_sub_fetch(&sf->hdr->n_open, 1, __ATOMIC_RELAXED);
+        _shm_detach(sf);
+    }
+    if (sf != NULL) {
+        sf->is_ctl = 0;
+    }
+
+    return  close(fd);
+}
+
+/**
+ * _shm_buf_rw()
+ * @brief    ZNDKCDEV_BUF_RD/ZNDKCDEV_BUF_WR of one segment, same bounds as the driver
+ * @return   0, -2: out of range or empty
+ */
+static int
+_shm_buf_rw(TShmFile *sf, TZndkCdevMem *mem, int is_wr)
+{
+    if ((mem->ofs < 0) || (mem->len <= 0) || (mem->ofs > sf->len_buf - mem->len)) {
+        return  -2;
+    }
+
+    if (is_wr) {
+        pthread_rwlock_wrlock(&sf->hdr->lock);
+        memcpy(sf->buf + mem->ofs, mem->buf, mem->len);
+    } else {
+        pthread_rwlock_rdlock(&sf->hdr->lock);
+        memcpy(mem->buf, sf->buf + mem->ofs, mem->len);
+    }
+    pthread_rwlock_unlock(&sf->hdr->lock);
+
+    return  0;
+}
+
+/**
+ * _shm_resize()
+ * @brief    ZNDKCDEV_BUF_RESIZE: only the sole opener w/o mappings may resize
+ */
+static int
+_shm_resize(int fd, TShmFile *sf, unsigned long len)
+{
+    int       stat = 0;
+    int       busy;
+
+    if ((len < SHM_LEN_HDR) || (len > ZNDKCDEV_MAX_BUF)) {
+        errno = EINVAL;
+        return  -1;
+    }
+    if (flock(fd, LOCK_EX) < 0) { /* keep new openers out until the object is rebuilt */
+        return  -1;
+    }
+    pthread_rwlock_wrlock(&sf->hdr->lock);
+    busy = (sf->hdr->n_open > 1) || (sf->hdr->n_mmap > 0);
+    pthread_rwlock_unlock(&sf->hdr->lock);
+    if (busy) {
+        flock(fd, LOCK_UN);
+        errno = EBUSY;
+        return  -1;
+    }
+
+    /* nobody else is attached nor attaching: rebuild the object at the new size */
+    _shm_detach(sf);
+    if ((_shm_init(fd, (int)len) < 0) || (_shm_attach(fd, sf) < 0)) {
+        stat = -1;
+    } else {
+        sf->hdr->n_open = 1;
+    }
+    flock(fd, LOCK_UN);
+
+    return  stat;
+}
+
+/**
+ * _shm_ctl_ioctl()
+ * @brief    ZNDKCDEV_CTL_* on the emulated /dev/zndkcdev_ctl
+ */
+static int
+_shm_ctl_ioctl(unsigned long cmd, void *arg)
+{
+    TZndkCdevCreate *crt = (TZndkCdevCreate *)arg;
+    char             name[64];
+    TShmFile         sf  = { NULL };
+    int              minor;
+    int              fd;
+    int              busy;
+
+    switch (cmd) {
+    case ZNDKCDEV_CTL_CREATE:
+        if ((crt->minor >= ZNDKCDEV_MAX_DEV) || (crt->len_buf < 0) || (crt->len_buf > ZNDKCDEV_MAX_BUF)) {
+            errno = EINVAL;
+            return  -1;
+        }
+        for (minor = (crt->minor < 0) ? 0 : crt->minor; minor < ZNDKCDEV_MAX_DEV; minor++) {
+            if (_shm_create(minor, crt->len_buf) == 0) {
+                crt->minor   = minor;
+                crt->len_buf = (crt->len_buf != 0) ? crt->len_buf : LEN_ZNDKCDEV_BUF;
+                crt->len_buf = (crt->len_buf + SHM_LEN_HDR - 1) & ~(SHM_LEN_HDR - 1);
+                return  0;
+            }
+            if ((errno != EEXIST) || (crt->minor >= 0)) {
+                return  -1;     /* a fixed minor in use: EEXIST, as the driver */
+            }
+        }
+        errno = ENOSPC;
+        return  -1;
+    case ZNDKCDEV_CTL_DESTROY:
+        minor = (int)(unsigned long)arg;
+        snprintf(name, sizeof(name), "/%s_%d", NAME_MODULE, minor);
+        fd = shm_open(name, O_RDWR, 0600);
+        if ((fd < 0) || (flock(fd, LOCK_SH) < 0) || (_shm_attach(fd, &sf) < 0)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            errno = ENOENT;
+            return  -1;
+        }
+        busy = (sf.hdr->n_open > 0) || (sf.hdr->n_mmap > 0);
+        _shm_detach(&sf);
+        close(fd);              /* drops LOCK_SH */
+        if (busy) {
+            errno = EBUSY;
+            return  -1;
+        }
+        return  shm_unlink(name);
+    default:
+        errno = ENOTTY;
+        return  -1;
+    }
+}
+
+/**
+ * _shm_ioctl()
+ * @brief    the ZNDKCDEV_* commands of the flat mode
+ */
+static int
+_shm_ioctl(int fd, unsigned long cmd, void *arg)
+{
+    TShmFile         *sf    = _get_shm_file(fd);
+    TZndkCdevMem     *mem   = (TZndkCdevMem     *)arg;
+    TZndkCdevMemVec  *vec   = (TZndkCdevMemVec  *)arg;
+    TZndkCdevFeature *feat  = (TZndkCdevFeature *)arg;
+    TSigMsg          *msg   = (TSigMsg          *)arg;
+    TZndkCdevXfer    *xf    = (TZndkCdevXfer    *)arg;
+    union sigval      val;
+    int               n_err = 0;
+    int               rslt;
+    int               i;
+
+    if ((sf != NULL) && sf->is_ctl) {
+        return  _shm_ctl_ioctl(cmd, arg);
+    }
+    if ((sf == NULL) || (sf->hdr == NULL)) {
+        errno = EBADF;
+        return  -1;
+    }
+
+    switch (cmd) {
+    case ZNDKCDEV_GET_VERSION:
+        strncpy((char *)arg, ZNDKCDEV_VERSION, LEN_VER + 1);
+        return  0;
+    case ZNDKCDEV_GET_BUF_LEN:
+        *(int *)arg = sf->len_buf;
+        return  0;
+    case ZNDKCDEV_GET_FEATURE:
+        memset(feat, 0, sizeof(TZndkCdevFeature));
+        strncpy(feat->ver, ZNDKCDEV_VERSION, LEN_VER);
+        feat->len_buf  = sf->len_buf;
+        feat->map_size = SHM_LEN_HDR;
+        return  0;
+    case ZNDKCDEV_BUF_RD:
+    case ZNDKCDEV_BUF_WR:
+        if (_shm_buf_rw(sf, mem, (cmd == ZNDKCDEV_BUF_WR)) < 0) {
+            errno = EINVAL;     /* as the driver */
+            return  -1;
+        }
+        return  0;
+    case ZNDKCDEV_BUF_RDV:
+    case ZNDKCDEV_BUF_WRV:
+        if ((vec->n_mem < 0) || (vec->n_mem > ZNDKCDEV_MEMVEC_MAX)) {
+            errno = EINVAL;
+            return  -1;
+        }
+        for (i = 0; i < vec->n_mem; i++) {
+            rslt = _shm_buf_rw(sf, &vec->mem[i], (cmd == ZNDKCDEV_BUF_WRV));
+            if (vec->stat != NULL) {
+                vec->stat[i] = (rslt < 0) ? -EINVAL : 0;  /* as the driver */
+            }
+            n_err += (rslt != 0);
+        }
+        return  n_err;
+    case ZNDKCDEV_BUF_SYNC:
+        if ((mem->ofs < 0) || (mem->len <= 0) || (mem->ofs > sf->len_buf - mem->len)) {
+            errno = EINVAL;
+            return  -1;
+        }
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); /* plain RAM: ordering is all there is to do */
+        return  0;
+    case ZNDKCDEV_BUF_FILL:
+    case ZNDKCDEV_BUF_MOVE:     /* COPY needs the other minor's object: module only */
+        if ((xf->len <= 0) || (xf->dst_ofs < 0) || (xf->dst_ofs > sf->len_buf - xf->len) ||
+            ((cmd == ZNDKCDEV_BUF_MOVE) && ((xf->src_ofs < 0) || (xf->src_ofs > sf->len_buf - xf->len)))) {
+            errno = EINVAL;
+            return  -1;
+        }
+        pthread_rwlock_wrlock(&sf->hdr->lock);
+        if (cmd == ZNDKCDEV_BUF_FILL) {
+            memset (sf->buf + xf->dst_ofs, xf->val, xf->len);
+        } else {
+            memmove(sf->buf + xf->dst_ofs, sf->buf + xf->src_ofs, xf->len);
+        }
+        pthread_rwlock_unlock(&sf->hdr->lock);
+        return  0;
+    case ZNDKCDEV_SET_MMAP:
+        if (((unsigned long)arg != ZNDKCDEV_MMAP_WB) && ((unsigned long)arg != ZNDKCDEV_MMAP_WC) &&
+            ((unsigned long)arg != ZNDKCDEV_MMAP_UC)) {
+            errno = EINVAL;
+            return  -1;
+        }
+        return  0;              /* shm pages are always write-back */
+    case ZNDKCDEV_BUF_RESIZE:
+        return  _shm_resize(fd, sf, (unsigned long)arg);
+    case ZNDKCDEV_SET_MODE:
+        if ((unsigned long)arg != ZNDKCDEV_MODE_FLAT) {
+            errno = EINVAL;
+            return  -1;
+        }
+        return  0;
+    case ZNDKCDEV_GET_MODE:
+        *(int *)arg = ZNDKCDEV_MODE_FLAT;
+        return  0;
+    case ZNDKCDEV_SIGNAL:
+        val.sival_int = msg->dat;
+        return  sigqueue(msg->pid, SIGUSR1, val); /* SI_QUEUE w/ si_int, as the driver */
+    case ZNDKCDEV_PRINTK:
+        printf(" %s[shm]: %s\n", NAME_MODULE, (const char *)arg);
+        return  0;
+    case ZNDKCDEV_TEST:
+        return  0;
+    default:                    /* SHARD_DRAIN, GET_STATS, ...: need the kernel module */
+        errno = ENOTTY;
+        return  -1;
+    }
+}
+
+/**
+ * _shm_mmap()
+ */
+static void *
+_shm_mmap(int fd, size_t len, off_t ofs, int prot, int flags)
+{
+    TShmFile *sf = _get_shm_file(fd);
+    void     *map;
+
+    /* the header page behind the buffer stays out of reach, as on the device */
+    if ((sf == NULL) || (sf->hdr == NULL) || (ofs < 0) || (ofs > sf->len_buf) ||
+        (len > (size_t)(sf->len_buf - ofs))) {
+        errno = EINVAL;
+        return  MAP_FAILED;
+    }
+    map = mmap(NULL, len, prot, MAP_SHARED | flags, fd, ofs);
+    if (map != MAP_FAILED) {
+        __atomic_add_fetch(&sf->hdr->n_mmap, 1, __ATOMIC_RELAXED);
+    }
+
+    return  map;
+}
+
+/**
+ * _shm_munmap()
+ */
+static int
+_shm_munmap(int fd, void *map, size_t len)
+{
+    TShmFile *sf   = _get_shm_file(fd);
+    int       stat = munmap(map, len);
+
+    if ((stat == 0) && (sf != NULL) && (sf->hdr != NULL)) {
+        __atomic_sub_fetch(&sf->hdr->n_mmap, 1, __ATOMIC_RELAXED);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_backend_shm
+ */
+const TZndkCdevBackend  zndkcdev_backend_shm = {
+    .name   = "shm"      ,
+    .open   = _shm_open  ,
+    .close  = _shm_close ,
+    .ioctl  = _shm_ioctl ,
+    .mmap   = _shm_mmap  ,
+    .munmap = _shm_munmap,
+};
+
+/* end */
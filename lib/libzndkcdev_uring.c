@@ -0,0 +1,476 @@
+/**
+ * @file     libzndkcdev_uring.c
+ * @brief    libzndkcdev asynchronous API on io_uring (raw syscalls, no liburing)
+ *
+ * @note     one ring keeps many transfers in flight against any number of
+ *           /dev/zndkcdev_<n> fds:
+ *           zndkcdev_uring_(read|write)[_fixed]() : IORING_OP_(READ|WRITE)[_FIXED] -> read_iter/write_iter
+ *           zndkcdev_uring_buf_(read|write)()    : IORING_OP_URING_CMD w/ ZNDKCDEV_BUF_(RD|WR)
+ *           requests are queued, zndkcdev_uring_submit() hands them to the kernel and
+ *           zndkcdev_uring_wait() runs the completion callbacks.
+ *
+ * @note     a ring is not thread-safe: use one ring per thread
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#include <errno.h>              /* errno       */
+#include <stdio.h>              /* printf()    */
+#include <stdlib.h>             /* calloc()    */
+#include <string.h>             /* memset()    */
+#include <unistd.h>             /* syscall()   */
+#include <linux/io_uring.h>     /* io_uring_*  */
+#include <sys/mman.h>           /* mmap()      */
+#include <sys/syscall.h>        /* __NR_io_uring_* */
+#include <sys/uio.h>            /* iovec       */
+
+#include    "zndkcdev.h"        /* zndk driver */
+#include "libzndkcdev.h"        /* zndk lib    */
+
+/* the 16 B command area of a 64 B SQE carries a TZndkCdevMem */
+_Static_assert(sizeof(TZndkCdevMem) <= 16, "TZndkCdevMem must fit in sqe->cmd");
+
+/**
+ * @struct TZndkCdevUringReq
+ * @brief  completion of one request (slot # = user_data)
+ */
+typedef struct {
+    TZndkCdevUringCb  cb;       /* NULL: free slot                   */
+    void             *user;     /* passed to cb()                    */
+} TZndkCdevUringReq;
+
+/**
+ * @struct TZndkCdevUring
+ * @brief  io_uring instance w/ its mmap'ed SQ/CQ rings
+ */
+struct TZndkCdevUring {
+    int                   ring_fd;  /* io_uring fd                       */
+
+    void                 *sq_ptr;   /* SQ ring mapping                   */
+    size_t                sq_len;
+    unsigned             *sq_head;  /* consumed by the kernel            */
+    unsigned             *sq_tail;  /* produced by us                    */
+    unsigned             *sq_mask;
+    unsigned             *sq_array;
+    unsigned              sq_entries;
+    struct io_uring_sqe  *sqes;     /* SQE array mapping                 */
+    size_t                sqes_len;
+    unsigned              sq_local; /* tail incl. not yet published SQEs */
+
+    void                 *cq_ptr;   /* CQ ring mapping (== sq_ptr: single mmap) */
+    size_t                cq_len;
+    unsigned             *cq_head;  /* consumed by us                    */
+    unsigned             *cq_tail;  /* produced by the kernel            */
+    unsigned             *cq_mask;
+    struct io_uring_cqe  *cqes;
+
+    TZndkCdevUringReq    *req;      /* [n_req]                           */
+    unsigned             *free;     /* stack of free slots               */
+    unsigned              n_req;    /* = CQ entries: bounds the in-flight count */
+    unsigned              n_free;
+};
+
+/**
+ * _uring_setup(), _uring_enter(), _uring_register()
+ */
+static inline int
+_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return  (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int
+_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return  (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline int
+_uring_register(int fd, unsigned opcode, const void *arg, unsigned n_arg)
+{
+    return  (int)syscall(__NR_io_uring_register, fd, opcode, arg, n_arg);
+}
+
+/**
+ * _uring_cb_nop()
+ * @brief    completion callback of requests queued w/o one
+ */
+static void
+_uring_cb_nop(void *user, int res)
+{
+    (void)user;
+    (void)res;
+}
+
+/**
+ * _uring_get_sqe()
+ * @brief    take the next SQE and a completion slot
+ * @return   cleared SQE w/ user_data set (NULL w/ errno = EBUSY: reap first)
+ */
+static struct io_uring_sqe *
+_uring_get_sqe(TZndkCdevUring *ur, TZndkCdevUringCb cb, void *user)
+{
+    struct io_uring_sqe *sqe;
+    unsigned             head = __atomic_load_n(ur->sq_head, __ATOMIC_ACQUIRE);
+    unsigned             idx;
+    unsigned             slot;
+
+    if (((ur->sq_local - head) >= ur->sq_entries) || (ur->n_free == 0)) {
+        errno = EBUSY;
+        return  NULL;
+    }
+
+    slot                = ur->free[--ur->n_free];
+    ur->req[slot].cb    = (cb != NULL) ? cb : _uring_cb_nop;
+    ur->req[slot].user  = user;
+
+    idx                 = ur->sq_local & *ur->sq_mask;
+    sqe                 = &ur->sqes[idx];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data      = slot;
+    ur->sq_array[idx]   = idx;
+    ur->sq_local++;
+
+    return  sqe;
+}
+
+/**
+ * _uring_prep_rw()
+ */
+static int
+_uring_prep_rw(TZndkCdevUring *ur, int op, int fd, void *buf, unsigned len, uint64_t off,
+               int buf_idx, TZndkCdevUringCb cb, void *user)
+{
+    struct io_uring_sqe *sqe = _uring_get_sqe(ur, cb, user);
+
+    if (sqe == NULL) {
+        return  -1;
+    }
+    sqe->opcode    = op;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t)(uintptr_t)buf;
+    sqe->len       = len;
+    sqe->off       = off;
+    sqe->buf_index = (buf_idx >= 0) ? buf_idx : 0;
+
+    return  0;
+}
+
+/**
+ * _uring_prep_cmd()
+ */
+static int
+_uring_prep_cmd(TZndkCdevUring *ur, int fd, unsigned cmd_op, void *buf, int ofs, int len,
+                TZndkCdevUringCb cb, void *user)
+{
+    struct io_uring_sqe *sqe = _uring_get_sqe(ur, cb, user);
+    TZndkCdevMem         mem = { buf, ofs, len };
+
+    if (sqe == NULL) {
+        return  -1;
+    }
+    sqe->opcode    = IORING_OP_URING_CMD;
+    sqe->fd        = fd;
+    sqe->cmd_op    = cmd_op;
+    memcpy(sqe->cmd, &mem, sizeof(TZndkCdevMem));
+
+    return  0;
+}
+
+/**
+ * zndkcdev_uring_create()
+ * @brief    create an io_uring instance for asynchronous zndkcdev transfers
+ *
+ * @param    [in]   depth      unsigned ::= # of SQ entries (in-flight up to 2x)
+ * @return         *ur   TZndkCdevUring ::= ring (NULL: error, e.g., io_uring disabled)
+ */
+TZndkCdevUring *
+zndkcdev_uring_create(unsigned depth)
+{
+    struct io_uring_params  p;
+    TZndkCdevUring         *ur;
+    unsigned                i;
+
+    ur = calloc(1, sizeof(TZndkCdevUring));
+    if (ur == NULL) {
+        return  NULL;
+    }
+
+    memset(&p, 0, sizeof(p));
+    ur->ring_fd = _uring_setup(depth, &p);
+    if (ur->ring_fd < 0) {
+        printf(" %s(): error: io_uring_setup (%d)\n", __func__, errno);
+        free(ur);
+        return  NULL;
+    }
+
+    /* SQ/CQ rings: one mapping on kernels w/ IORING_FEAT_SINGLE_MMAP */
+    ur->sq_len  = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ur->cq_len  = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ur->sq_len = (ur->cq_len > ur->sq_len) ? ur->cq_len : ur->sq_len;
+    }
+    ur->sq_ptr  = mmap(NULL, ur->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ur->ring_fd, IORING_OFF_SQ_RING);
+    if (ur->sq_ptr == MAP_FAILED) {
+        goto  create_err_close;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ur->cq_ptr = ur->sq_ptr;
+    } else {
+        ur->cq_ptr = mmap(NULL, ur->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ur->ring_fd, IORING_OFF_CQ_RING);
+        if (ur->cq_ptr == MAP_FAILED) {
+            goto  create_err_sq;
+        }
+    }
+    ur->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ur->sqes     = mmap(NULL, ur->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ur->ring_fd, IORING_OFF_SQES);
+    if (ur->sqes == MAP_FAILED) {
+        goto  create_err_cq;
+    }
+
+    ur->sq_head    = (unsigned *)((char *)ur->sq_ptr + p.sq_off.head        );
+    ur->sq_tail    = (unsigned *)((char *)ur->sq_ptr + p.sq_off.tail        );
+    ur->sq_mask    = (unsigned *)((char *)ur->sq_ptr + p.sq_off.ring_mask   );
+    ur->sq_array   = (unsigned *)((char *)ur->sq_ptr + p.sq_off.array       );
+    ur->sq_entries = p.sq_entries;
+    ur->sq_local   = *ur->sq_tail;
+    ur->cq_head    = (unsigned *)((char *)ur->cq_ptr + p.cq_off.head        );
+    ur->cq_tail    = (unsigned *)((char *)ur->cq_ptr + p.cq_off.tail        );
+    ur->cq_mask    = (unsigned *)((char *)ur->cq_ptr + p.cq_off.ring_mask   );
+    ur->cqes       = (struct io_uring_cqe *)((char *)ur->cq_ptr + p.cq_off.cqes);
+
+    /* one slot per CQ entry: the CQ can never overflow */
+    ur->n_req      = p.cq_entries;
+    ur->req        = calloc(ur->n_req, sizeof(TZndkCdevUringReq));
+    ur->free       = calloc(ur->n_req, sizeof(unsigned));
+    if ((ur->req == NULL) || (ur->free == NULL)) {
+        goto  create_err_sqes;
+    }
+    for (i = 0; i < ur->n_req; i++) {
+        ur->free[i] = ur->n_req - 1 - i;
+    }
+    ur->n_free     = ur->n_req;
+
+    return  ur;
+
+create_err_sqes:
+    free(ur->req);
+    free(ur->free);
+    munmap(ur->sqes, ur->sqes_len);
+create_err_cq:
+    if (ur->cq_ptr != ur->sq_ptr) {
+        munmap(ur->cq_ptr, ur->cq_len);
+    }
+create_err_sq:
+    munmap(ur->sq_ptr, ur->sq_len);
+create_err_close:
+    printf(" %s(): error: mmap (%d)\n", __func__, errno);
+    close(ur->ring_fd);
+    free(ur);
+
+    return  NULL;
+}
+
+/**
+ * zndkcdev_uring_destroy()
+ * @brief    tear down a ring (in-flight requests are cancelled by the kernel)
+ *
+ * @param    [in]  *ur   TZndkCdevUring ::= ring
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_uring_destroy(TZndkCdevUring *ur)
+{
+    if (ur == NULL) {
+        return  -1;
+    }
+
+    munmap(ur->sqes, ur->sqes_len);
+    if (ur->cq_ptr != ur->sq_ptr) {
+        munmap(ur->cq_ptr, ur->cq_len);
+    }
+    munmap(ur->sq_ptr, ur->sq_len);
+    close(ur->ring_fd);
+    free(ur->req);
+    free(ur->free);
+    free(ur);
+
+    return  0;
+}
+
+/**
+ * zndkcdev_uring_register_buffers()
+ * @brief    pin user buffers once for zndkcdev_uring_(read|write)_fixed()
+ *
+ * @param    [in]  *ur   TZndkCdevUring ::= ring
+ * @param    [in]  *iov    struct iovec ::= buffers, referred to by index
+ * @param    [in]   n_iov           int ::= # of buffers
+ * @return          stat            int ::= process status
+ */
+int
+zndkcdev_uring_register_buffers(TZndkCdevUring *ur, const struct iovec *iov, int n_iov)
+{
+    int     stat;
+
+    stat = _uring_register(ur->ring_fd, IORING_REGISTER_BUFFERS, iov, n_iov);
+    if (stat < 0) {
+        printf(" %s(): error: io_uring_register (%d)\n", __func__, errno);
+    }
+
+    return  stat;
+}
+
+/**
+ * zndkcdev_uring_read()
+ * @brief    queue a read(2) of the device buffer at off (IORING_OP_READ)
+ *
+ * @param    [in]  *ur   TZndkCdevUring ::= ring
+ * @param    [in]   fd              int ::= file descriptor of /dev/zndkcdev_<n>
+ * @param    [out] *buf            void ::= read buffer
+ * @param    [in]   len        unsigned ::= length to be read
+ * @param    [in]   off        uint64_t ::= offset from top of driver buffer
+ * @param    [in]   cb  TZndkCdevUringCb ::= completion callback (NULL: none)
+ * @param    [in]  *user           void ::= passed to cb()
+ * @return          stat            int ::= process status (-1 w/ EBUSY: queue full, reap first)
+ */
+int
+zndkcdev_uring_read(TZndkCdevUring *ur, int fd, void *buf, unsigned len, uint64_t off,
+                    TZndkCdevUringCb cb, void *user)
+{
+    return  _uring_prep_rw(ur, IORING_OP_READ , fd, buf, len, off, -1, cb, user);
+}
+
+/**
+ * zndkcdev_uring_write()
+ * @brief    queue a write(2) to the device buffer at off (IORING_OP_WRITE)
+ */
+int
+zndkcdev_uring_write(TZndkCdevUring *ur, int fd, const void *buf, unsigned len, uint64_t off,
+                     TZndkCdevUringCb cb, void *user)
+{
+    return  _uring_prep_rw(ur, IORING_OP_WRITE, fd, (void *)buf, len, off, -1, cb, user);
+}
+
+/**
+ * zndkcdev_uring_read_fixed()
+ * @brief    zndkcdev_uring_read() into registered buffer buf_idx (buf lies inside it)
+ */
+int
+zndkcdev_uring_read_fixed(TZndkCdevUring *ur, int fd, int buf_idx, void *buf, unsigned len, uint64_t off,
+                          TZndkCdevUringCb cb, void *user)
+{
+    return  _uring_prep_rw(ur, IORING_OP_READ_FIXED , fd, buf, len, off, buf_idx, cb, user);
+}
+
+/**
+ * zndkcdev_uring_write_fixed()
+ * @brief    zndkcdev_uring_write() from registered buffer buf_idx (buf lies inside it)
+ */
+int
+zndkcdev_uring_write_fixed(TZndkCdevUring *ur, int fd, int buf_idx, const void *buf, unsigned len, uint64_t off,
+                           TZndkCdevUringCb cb, void *user)
+{
+    return  _uring_prep_rw(ur, IORING_OP_WRITE_FIXED, fd, (void *)buf, len, off, buf_idx, cb, user);
+}
+
+/**
+ * zndkcdev_uring_buf_read()
+ * @brief    queue ZNDKCDEV_BUF_RD (IORING_OP_URING_CMD): same as zndkcdev_buf_read(), asynchronously
+ */
+int
+zndkcdev_uring_buf_read(TZndkCdevUring *ur, int fd, int ofs, int len, void *rbuf,
+                        TZndkCdevUringCb cb, void *user)
+{
+    return  _uring_prep_cmd(ur, fd, ZNDKCDEV_BUF_RD, rbuf, ofs, len, cb, user);
+}
+
+/**
+ * zndkcdev_uring_buf_write()
+ * @brief    queue ZNDKCDEV_BUF_WR (IORING_OP_URING_CMD): same as zndkcdev_buf_write(), asynchronously
+ */
+int
+zndkcdev_uring_buf_write(TZndkCdevUring *ur, int fd, int ofs, int len, const void *wbuf,
+                         TZndkCdevUringCb cb, void *user)
+{
+    return  _uring_prep_cmd(ur, fd, ZNDKCDEV_BUF_WR, (void *)wbuf, ofs, len, cb, user);
+}
+
+/**
+ * zndkcdev_uring_submit()
+ * @brief    hand the queued requests to the kernel (one syscall for all of them)
+ *
+ * @param    [in]  *ur   TZndkCdevUring ::= ring
+ * @return          n_sub           int ::= # of requests submitted (< 0: error)
+ */
+int
+zndkcdev_uring_submit(TZndkCdevUring *ur)
+{
+    unsigned  n_new = ur->sq_local - *ur->sq_tail;
+    int       n_sub;
+
+    if (n_new == 0) {
+        return  0;
+    }
+    __atomic_store_n(ur->sq_tail, ur->sq_local, __ATOMIC_RELEASE);
+
+    n_sub = _uring_enter(ur->ring_fd, n_new, 0, 0);
+    if (n_sub < 0) {
+        printf(" %s(): error: io_uring_enter (%d)\n", __func__, errno);
+    }
+
+    return  n_sub;
+}
+
+/**
+ * zndkcdev_uring_wait()
+ * @brief    submit what is queued, wait for min_complete completions and run their callbacks
+ *
+ * @param    [in]  *ur   TZndkCdevUring ::= ring
+ * @param    [in]   min_complete unsigned ::= # of completions to wait for (0: just reap)
+ * @return          n_cqe           int ::= # of completions reaped (< 0: error)
+ */
+int
+zndkcdev_uring_wait(TZndkCdevUring *ur, unsigned min_complete)
+{
+    struct io_uring_cqe *cqe;
+    TZndkCdevUringReq    req;
+    unsigned             n_new = ur->sq_local - *ur->sq_tail;
+    unsigned             head;
+    unsigned             tail;
+    int                  n_cqe = 0;
+
+    __atomic_store_n(ur->sq_tail, ur->sq_local, __ATOMIC_RELEASE);
+
+    head = *ur->cq_head;
+    tail = __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE);
+    if ((n_new != 0) || ((tail - head) < min_complete)) {
+        if (_uring_enter(ur->ring_fd, n_new, min_complete, (min_complete != 0) ? IORING_ENTER_GETEVENTS : 0) < 0) {
+            if (errno != EINTR) {
+                printf(" %s(): error: io_uring_enter (%d)\n", __func__, errno);
+                return  -1;
+            }
+        }
+        tail = __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    for (; head != tail; head++, n_cqe++) {
+        cqe = &ur->cqes[head & *ur->cq_mask];
+        req = ur->req[cqe->user_data];
+
+        ur->req[cqe->user_data].cb = NULL;
+        ur->free[ur->n_free++]     = (unsigned)cqe->user_data;
+        __atomic_store_n(ur->cq_head, head + 1, __ATOMIC_RELEASE); /* callback may queue again */
+
+        req.cb(req.user, cqe->res);
+    }
+
+    return  n_cqe;
+}
+
+/* end */
@@ -0,0 +1,222 @@
+/**
+ * @file     zndkcdev.hpp
+ * @brief    header-only C++17/20 wrapper of libzndkcdev
+ *
+ * @note     zndkcdev::Device owns the fd and the mapping (move-only, RAII);
+ *           bytes()/view<T>() are zero-copy views over the mapped buffer and
+ *           read_into()/write_from() issue ZNDKCDEV_BUF_RD/ZNDKCDEV_BUF_WR
+ *           straight through the handle's transport (no copy, no logging).
+ *           errors are thrown as std::system_error / std::out_of_range.
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#ifndef    ZNDKCDEV_HPP
+#define    ZNDKCDEV_HPP
+
+#include <cerrno>               /* errno              */
+#include <cstddef>              /* std::byte          */
+#include <cstdint>              /* uintptr_t          */
+#include <stdexcept>            /* std::out_of_range  */
+#include <system_error>         /* std::system_error  */
+#include <type_traits>          /* is_trivially_copyable */
+#include <utility>              /* std::exchange      */
+#if (__cplusplus >= 202002L) && __has_include(<span>)
+#include <span>                 /* std::span          */
+#endif
+
+#include "libzndkcdev.h"        /* zndk lib    */
+
+namespace zndkcdev {
+
+#if defined(__cpp_lib_span)
+template <class T> using span = std::span<T>;
+#else
+/**
+ * @class  span
+ * @brief  C++17 stand-in for std::span<T> (dynamic extent only)
+ */
+template <class T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr T          *data()       const noexcept { return data_;                  }
+    constexpr std::size_t size()       const noexcept { return size_;                  }
+    constexpr std::size_t size_bytes() const noexcept { return size_ * sizeof(T);      }
+    constexpr bool        empty()      const noexcept { return size_ == 0;             }
+    constexpr T          *begin()      const noexcept { return data_;                  }
+    constexpr T          *end()        const noexcept { return data_ + size_;          }
+    constexpr T          &operator[](std::size_t i) const noexcept { return data_[i];  }
+    constexpr span        subspan(std::size_t ofs, std::size_t cnt) const noexcept { return span(data_ + ofs, cnt); }
+
+private:
+    T          *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+/**
+ * @class  Device
+ * @brief  one open /dev/zndkcdev_<n> (TDevHandle) w/ its lazily created mapping
+ */
+class Device {
+public:
+    Device() noexcept = default;
+
+    /**
+     * Device()
+     * @brief    open the device (std::system_error on failure)
+     */
+    explicit Device(const char *path)
+        : hdl_(zndkcdev_hdl_open(path))
+    {
+        if (hdl_ == nullptr) {
+            throw std::system_error(errno, std::generic_category(), "zndkcdev: open");
+        }
+    }
+
+    ~Device() { reset(); }
+
+    Device(Device &&other) noexcept : hdl_(std::exchange(other.hdl_, nullptr)) {}
+    Device &operator=(Device &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            hdl_ = std::exchange(other.hdl_, nullptr);
+        }
+        return  *this;
+    }
+    Device(const Device &)            = delete;
+    Device &operator=(const Device &) = delete;
+
+    /**
+     * reset()
+     * @brief    unmap and close (no-op on a moved-from/empty Device)
+     */
+    void reset() noexcept
+    {
+        if (hdl_ != nullptr) {
+            zndkcdev_hdl_close(std::exchange(hdl_, nullptr));
+        }
+    }
+
+    explicit operator bool() const noexcept { return hdl_ != nullptr;                 }
+    TDevHandle  *handle()    const noexcept { return hdl_;                            }
+    int          fd()        const noexcept { return hdl_->fd;                        }
+    std::size_t  size()      const noexcept { return static_cast<std::size_t>(hdl_->len_buf); }
+
+    /**
+     * bytes()
+     * @brief    the whole driver buffer, mmap'ed on first use (std::system_error on failure)
+     */
+    span<std::byte> bytes()
+    {
+        std::byte *map = reinterpret_cast<std::byte *>(hdl_->buf_virt);
+
+        if (map == nullptr) {
+            map = reinterpret_cast<std::byte *>(zndkcdev_hdl_mmap(hdl_));
+            if (map == nullptr) {
+                throw std::system_error(errno, std::generic_category(), "zndkcdev: mmap");
+            }
+        }
+        return  span<std::byte>(map, size());
+    }
+
+    /**
+     * view()
+     * @brief    count T's at byte offset ofs of the mapping, w/o copying
+     *           (std::out_of_range: past the buffer or misaligned for T)
+     */
+    template <class T>
+    span<T> view(std::size_t ofs, std::size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "view<T>: T must be trivially copyable");
+
+        span<std::byte> buf = bytes();
+
+        if ((ofs > buf.size()) || (count > (buf.size() - ofs) / sizeof(T))) {
+            throw std::out_of_range("zndkcdev: view past the buffer");
+        }
+        if ((reinterpret_cast<std::uintptr_t>(buf.data() + ofs) % alignof(T)) != 0) {
+            throw std::out_of_range("zndkcdev: view misaligned");
+        }
+        return  span<T>(reinterpret_cast<T *>(buf.data() + ofs), count);
+    }
+
+    /**
+     * read_into(), write_from()
+     * @brief    one ZNDKCDEV_BUF_RD/ZNDKCDEV_BUF_WR between the buffer at ofs and obj (or a span of T's)
+     * @note     the driver bounds the range by its flat length (len_buf, or one frame in
+     *           FLIP mode); a range past it or an empty one throws std::out_of_range
+     */
+    template <class T>
+    void read_into (std::size_t ofs, T &obj)         { rw<T>(ZNDKCDEV_BUF_RD, ofs, &obj, sizeof(T)); }
+    template <class T>
+    void read_into (std::size_t ofs, span<T> objs)   { rw<T>(ZNDKCDEV_BUF_RD, ofs, objs.data(), objs.size() * sizeof(T)); }
+    template <class T>
+    void write_from(std::size_t ofs, const T &obj)   { rw<T>(ZNDKCDEV_BUF_WR, ofs, const_cast<T *>(&obj), sizeof(T)); }
+    template <class T>
+    void write_from(std::size_t ofs, span<const T> objs) { rw<T>(ZNDKCDEV_BUF_WR, ofs, const_cast<T *>(objs.data()), objs.size() * sizeof(T)); }
+
+    /**
+     * sync()
+     * @brief    ZNDKCDEV_BUF_SYNC of [ofs, ofs + len) after writing through a WC/UC mapping
+     *           (x86 only: throws w/ EOPNOTSUPP elsewhere)
+     */
+    void sync(std::size_t ofs, std::size_t len)
+    {
+        TZndkCdevMem mem = { nullptr, static_cast<int>(ofs), static_cast<int>(len) };
+
+        ioctl(ZNDKCDEV_BUF_SYNC, &mem, "zndkcdev: BUF_SYNC");
+    }
+
+private:
+    template <class T>
+    void rw(unsigned long cmd, std::size_t ofs, T *obj, std::size_t len)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "read_into/write_from: T must be trivially copyable");
+
+        /* the driver checks the range against the current mode: no extra ioctl per transfer */
+        if ((ofs > size()) || (len == 0) || (len > size() - ofs)) {
+            throw std::out_of_range("zndkcdev: transfer past the buffer");
+        }
+
+        TZndkCdevMem mem = { obj, static_cast<int>(ofs), static_cast<int>(len) };
+
+        if (call(cmd, &mem) < 0) {
+            if (errno == EINVAL) {
+                throw std::out_of_range("zndkcdev: transfer past the buffer");
+            }
+            throw std::system_error(errno, std::generic_category(),
+                                    (cmd == ZNDKCDEV_BUF_RD) ? "zndkcdev: BUF_RD" : "zndkcdev: BUF_WR");
+        }
+    }
+
+    /* ioctl(2) straight on the module's fd, other transports through their backend */
+    int call(unsigned long cmd, void *arg)
+    {
+        if (hdl_->be == &zndkcdev_backend_dev) {
+            return  ::ioctl(hdl_->fd, cmd, arg);
+        }
+        return  hdl_->be->ioctl(hdl_->fd, cmd, arg);
+    }
+
+    void ioctl(unsigned long cmd, void *arg, const char *what)
+    {
+        if (call(cmd, arg) < 0) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+    }
+
+    TDevHandle *hdl_ = nullptr; /* NULL: empty/moved-from */
+};
+
+}  /* namespace zndkcdev */
+
+#endif  /* ZNDKCDEV_HPP */
+/* end */
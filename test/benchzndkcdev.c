@@ -0,0 +1,475 @@
+/**
+ * @file     benchzndkcdev.c
+ * @brief    throughput/latency benchmark for the zndkcdev transfer paths
+ *
+ * @note     sweeps {method} x {minor} x {# of threads} x {transfer size},
+ *           one result row per (method, direction) in CSV or JSON:
+ *           rw    : lseek() + read()/write()
+ *           prw   : pread()/pwrite()
+ *           ioctl : ZNDKCDEV_BUF_RD/ZNDKCDEV_BUF_WR
+ *           mmap  : memcpy() from/to the mmap'ed buffer
+ *
+ * @note     devices are opened, ioctl'ed and mapped through the libzndkcdev backend
+ *           ($ZNDKCDEV_BACKEND: "dev" or "shm"), so both transports are measured alike
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#include <errno.h>              /* errno        */
+#include <fcntl.h>              /* open()       */
+#include <pthread.h>            /* pthread_*()  */
+#include <stdint.h>             /* uint64_t     */
+#include <stdio.h>              /* printf()     */
+#include <stdlib.h>             /* qsort()      */
+#include <string.h>             /* memcpy()     */
+#include <time.h>               /* clock_gettime() */
+#include <unistd.h>             /* getopt()     */
+#include <sys/mman.h>           /* PROT_READ    */
+#include <sys/types.h>          /* pid_t        */
+
+#include    "zndkcdev.h"        /* zndk driver  */
+#include "libzndkcdev.h"        /* zndk lib     */
+
+/* definitions */
+#define  BENCH_MAX_LIST              16 /* max # of minors/thread counts   */
+#define  BENCH_MAX_THREAD           256 /* max # of threads per run        */
+#define  BENCH_MIN_SIZE              64 /* default smallest transfer [B]   */
+#define  BENCH_N_OP                1000 /* default max # of ops per thread */
+#define  BENCH_BUDGET  (64 * 1024 * 1024) /* default bytes per thread / run */
+#define  BENCH_MIN_OP                16 /* ops per thread, even for big sizes */
+
+#define  BENCH_METHOD_RW           0x01
+#define  BENCH_METHOD_PRW          0x02
+#define  BENCH_METHOD_IOCTL        0x04
+#define  BENCH_METHOD_MMAP         0x08
+#define  BENCH_METHOD_ALL          0x0F
+
+/**
+ * @struct  TBenchConf
+ * @brief   command line
+ */
+typedef struct {
+    int       minor   [BENCH_MAX_LIST]; /* /dev/zndkcdev_<minor>       */
+    int       n_minor;
+    int       n_thread[BENCH_MAX_LIST]; /* thread counts to sweep      */
+    int       n_n_thread;
+    int       size_min;         /* smallest transfer [B]             */
+    int       size_max;         /* largest  transfer [B] (0: buffer) */
+    int       n_op;             /* max # of ops per thread           */
+    long      budget;           /* bytes per thread and run          */
+    int       methods;          /* BENCH_METHOD_*                    */
+    int       json;             /* 0: CSV, 1: JSON                   */
+} TBenchConf;
+
+/**
+ * @struct  TBenchThread
+ * @brief   one worker of a run
+ */
+typedef struct {
+    const TZndkCdevBackend *be; /* transport of fd                   */
+    int       fd;               /* own fd: no shared file position   */
+    uint8_t  *map;              /* mmap'ed buffer (mmap method)      */
+    int       len_buf;          /* buffer size [B]                   */
+    int       method;           /* BENCH_METHOD_*                    */
+    int       is_wr;            /* 0: read, 1: write                 */
+    int       size;             /* transfer size [B]                 */
+    int       ofs;              /* buffer offset of this thread      */
+    int       n_op;             /* # of ops to run                   */
+    uint8_t  *data;             /* user buffer                       */
+    uint64_t *lat;              /* [n_op] latency [ns]               */
+    int       n_err;            /* # of failed ops                   */
+    pthread_barrier_t *bar;     /* start line                        */
+} TBenchThread;
+
+/**
+ * _bench_ns()
+ * @brief    CLOCK_MONOTONIC in [ns]
+ */
+static inline uint64_t
+_bench_ns(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return  (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * _bench_cmp()
+ * @brief    qsort() comparator for latencies
+ */
+static int
+_bench_cmp(const void *a, const void *b)
+{
+    uint64_t  x = *(const uint64_t *)a;
+    uint64_t  y = *(const uint64_t *)b;
+
+    return  (x > y) - (x < y);
+}
+
+/**
+ * _bench_op()
+ * @brief    one transfer of th->size bytes by th->method
+ * @return   0: ok, -1: error
+ */
+static int
+_bench_op(TBenchThread *th)
+{
+    TZndkCdevMem  mem  = { th->data, th->ofs, th->size };
+    ssize_t       n;
+
+    switch (th->method) {
+    case BENCH_METHOD_RW:
+        if (lseek(th->fd, th->ofs, SEEK_SET) < 0) {
+            return  -1;
+        }
+        n = (th->is_wr) ? write(th->fd, th->data, th->size) : read(th->fd, th->data, th->size);
+        return  (n == th->size) ? 0 : -1;
+    case BENCH_METHOD_PRW:
+        n = (th->is_wr) ? pwrite(th->fd, th->data, th->size, th->ofs) : pread(th->fd, th->data, th->size, th->ofs);
+        return  (n == th->size) ? 0 : -1;
+    case BENCH_METHOD_IOCTL:
+        return  (th->be->ioctl(th->fd, (th->is_wr) ? ZNDKCDEV_BUF_WR : ZNDKCDEV_BUF_RD, &mem) < 0) ? -1 : 0;
+    case BENCH_METHOD_MMAP:
+        if (th->is_wr) {
+            memcpy(th->map + th->ofs, th->data, th->size);
+        } else {
+            memcpy(th->data, th->map + th->ofs, th->size);
+        }
+        return  0;
+    default:
+        return  -1;
+    }
+}
+
+/**
+ * _bench_worker()
+ * @brief    pthread entry: run th->n_op transfers, record each latency
+ */
+static void *
+_bench_worker(void *arg)
+{
+    TBenchThread *th = (TBenchThread *)arg;
+    uint64_t      t0;
+    int           i;
+
+    pthread_barrier_wait(th->bar);
+    for (i = 0; i < th->n_op; i++) {
+        t0 = _bench_ns();
+        if (_bench_op(th) < 0) {
+            th->n_err++;
+        }
+        th->lat[i] = _bench_ns() - t0;
+    }
+
+    return  NULL;
+}
+
+/**
+ * _bench_emit()
+ * @brief    print one result row
+ */
+static void
+_bench_emit(const TBenchConf *conf, const char *method, int is_wr, int minor, int n_thread,
+            int size, long n_op, int n_err, double sec, uint64_t *lat)
+{
+    static int  n_row = 0;
+    double      mbps  = (double)n_op * size / sec / (1024.0 * 1024.0);
+    double      iops  = (double)n_op / sec;
+    uint64_t    p50   = lat[(n_op - 1) * 50   / 100  ];
+    uint64_t    p90   = lat[(n_op - 1) * 90   / 100  ];
+    uint64_t    p99   = lat[(n_op - 1) * 99   / 100  ];
+    uint64_t    p999  = lat[(n_op - 1) * 999  / 1000 ];
+    uint64_t    max   = lat[ n_op - 1];
+
+    if (conf->json) {
+        printf("%s\n  {\"method\": \"%s\", \"dir\": \"%s\", \"minor\": %d, \"threads\": %d, \"size\": %d, "
+               "\"ops\": %ld, \"errors\": %d, \"sec\": %.6f, \"mib_per_sec\": %.3f, \"ops_per_sec\": %.1f, "
+               "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+               (n_row == 0) ? "" : ",", method, (is_wr) ? "write" : "read", minor, n_thread, size,
+               n_op, n_err, sec, mbps, iops,
+               (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99,
+               (unsigned long long)p999, (unsigned long long)max);
+    } else {
+        printf("%s,%s,%d,%d,%d,%ld,%d,%.6f,%.3f,%.1f,%llu,%llu,%llu,%llu,%llu\n",
+               method, (is_wr) ? "write" : "read", minor, n_thread, size,
+               n_op, n_err, sec, mbps, iops,
+               (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99,
+               (unsigned long long)p999, (unsigned long long)max);
+    }
+    n_row++;
+}
+
+/**
+ * _bench_run()
+ * @brief    one point of the sweep: n_thread workers on /dev/zndkcdev_<minor>
+ * @return   0: ok, -1: setup error
+ */
+static int
+_bench_run(const TBenchConf *conf, int minor, int len_buf, int method, int is_wr, int n_thread, int size)
+{
+    static const char *name[] = { "", "rw", "prw", "", "ioctl", "", "", "", "mmap" };
+    const TZndkCdevBackend *be = zndkcdev_get_backend();
+    TBenchThread       th [BENCH_MAX_THREAD];
+    pthread_t          tid[BENCH_MAX_THREAD];
+    pthread_barrier_t  bar;
+    char               path[64];
+    long               n_op;
+    long               n_all = 0;
+    int                n_err = 0;
+    uint64_t          *lat;
+    uint64_t           t0;
+    uint64_t           t1;
+    int                stat  = 0;
+    int                i;
+
+    n_op = conf->budget / size;
+    n_op = (n_op < BENCH_MIN_OP) ? BENCH_MIN_OP : n_op;
+    n_op = (n_op > conf->n_op  ) ? conf->n_op   : n_op;
+
+    lat  = calloc((size_t)n_op * n_thread, sizeof(uint64_t));
+    if (lat == NULL) {
+        return  -1;
+    }
+    memset(th, 0, sizeof(th));
+    for (i = 0; i < n_thread; i++) {
+        th[i].fd      = -1;
+    }
+    snprintf(path, sizeof(path), "/dev/%s_%d", NAME_MODULE, minor);
+    pthread_barrier_init(&bar, NULL, n_thread + 1);
+
+    for (i = 0; i < n_thread; i++) {
+        th[i].be      = be;
+        th[i].fd      = be->open(path, O_RDWR);
+        th[i].len_buf = len_buf;
+        th[i].method  = method;
+        th[i].is_wr   = is_wr;
+        th[i].size    = size;
+        th[i].ofs     = (int)(((long)i * size) % (len_buf - size + 1)); /* spread threads over the buffer */
+        th[i].n_op    = n_op;
+        th[i].data    = malloc(size);
+        th[i].lat     = lat + (size_t)i * n_op;
+        th[i].bar     = &bar;
+        if ((th[i].fd < 0) || (th[i].data == NULL)) {
+            fprintf(stderr, " %s(): error: open %s (%d)\n", __func__, path, errno);
+            stat = -1;
+            break;
+        }
+        memset(th[i].data, i, size);
+        if (method == BENCH_METHOD_MMAP) {
+            th[i].map = be->mmap(th[i].fd, len_buf, 0, PROT_READ | PROT_WRITE, 0);
+            if (th[i].map == MAP_FAILED) {
+                fprintf(stderr, " %s(): error: mmap %s (%d)\n", __func__, path, errno);
+                th[i].map = NULL;
+                stat = -1;
+                break;
+            }
+        }
+    }
+
+    if (stat == 0) {
+        for (i = 0; i < n_thread; i++) {
+            pthread_create(&tid[i], NULL, _bench_worker, &th[i]);
+        }
+        t0 = _bench_ns();       /* before the start line: workers may be done before we wake */
+        pthread_barrier_wait(&bar);
+        for (i = 0; i < n_thread; i++) {
+            pthread_join(tid[i], NULL);
+            n_err += th[i].n_err;
+        }
+        t1 = _bench_ns();
+
+        n_all = n_op * n_thread;
+        qsort(lat, n_all, sizeof(uint64_t), _bench_cmp);
+        _bench_emit(conf, name[method], is_wr, minor, n_thread, size, n_all, n_err, (t1 - t0) / 1e9, lat);
+    }
+
+    for (i = 0; i < n_thread; i++) {
+        if (th[i].map != NULL) {
+            be->munmap(th[i].fd, th[i].map, len_buf);
+        }
+        if (th[i].fd >= 0) {
+            be->close(th[i].fd);
+        }
+        free(th[i].data);
+    }
+    pthread_barrier_destroy(&bar);
+    free(lat);
+
+    return  stat;
+}
+
+/**
+ * _bench_parse_list()
+ * @brief    "1,2,4" -> {1, 2, 4}
+ * @return   # of items
+ */
+static int
+_bench_parse_list(const char *arg, int *list)
+{
+    char     *end;
+    int       n   = 0;
+
+    while ((*arg != '\0') && (n < BENCH_MAX_LIST)) {
+        list[n++] = (int)strtol(arg, &end, 0);
+        arg       = (*end == ',') ? end + 1 : end;
+        if (end == arg) {
+            break;
+        }
+    }
+
+    return  n;
+}
+
+/**
+ * _bench_parse_methods()
+ * @brief    "rw,mmap" -> BENCH_METHOD_RW | BENCH_METHOD_MMAP
+ */
+static int
+_bench_parse_methods(char *arg)
+{
+    int       methods = 0;
+    char     *tok;
+
+    for (tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        methods |= (strcmp(tok, "rw"   ) == 0) ? BENCH_METHOD_RW    : 0;
+        methods |= (strcmp(tok, "prw"  ) == 0) ? BENCH_METHOD_PRW   : 0;
+        methods |= (strcmp(tok, "ioctl") == 0) ? BENCH_METHOD_IOCTL : 0;
+        methods |= (strcmp(tok, "mmap" ) == 0) ? BENCH_METHOD_MMAP  : 0;
+        methods |= (strcmp(tok, "all"  ) == 0) ? BENCH_METHOD_ALL   : 0;
+    }
+
+    return  methods;
+}
+
+/**
+ * _bench_next_size()
+ * @brief    64, 128, ... doubling, the last step is clipped to size_max
+ */
+static int
+_bench_next_size(int size, int size_max)
+{
+    if (size >= size_max) {
+        return  size_max + 1;   /* done */
+    }
+
+    return  (size > size_max / 2) ? size_max : size * 2;
+}
+
+/**
+ * _bench_usage()
+ */
+static void
+_bench_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-d minors] [-t threads] [-s min size] [-S max size] [-n ops] [-b bytes]\n"
+            "          [-m rw,prw,ioctl,mmap] [-j]\n"
+            "  -d  minors of /dev/%s_<n> to sweep       (default: 0)\n"
+            "  -t  thread counts to sweep               (default: 1,2,4)\n"
+            "  -s  smallest transfer size [B]            (default: %d)\n"
+            "  -S  largest  transfer size [B]            (default: buffer size)\n"
+            "  -n  max # of ops per thread and point     (default: %d)\n"
+            "  -b  bytes per thread and point            (default: %d)\n"
+            "  -m  methods                               (default: all)\n"
+            "  -j  JSON output                           (default: CSV)\n",
+            prog, NAME_MODULE, BENCH_MIN_SIZE, BENCH_N_OP, BENCH_BUDGET);
+}
+
+/**
+ * main()
+ * @brief    zndkcdev benchmark
+ *
+ * @param    [in]   argc        int ::= # of args
+ * @param    [in]  *argv[]     char ::= entity of args
+ */
+int
+main(int argc, char *argv[])
+{
+    TBenchConf  conf = { { 0 }, 1, { 1, 2, 4 }, 3, BENCH_MIN_SIZE, 0, BENCH_N_OP, BENCH_BUDGET, BENCH_METHOD_ALL, 0 };
+    static const int method[] = { BENCH_METHOD_RW, BENCH_METHOD_PRW, BENCH_METHOD_IOCTL, BENCH_METHOD_MMAP };
+    const TZndkCdevBackend *be = zndkcdev_get_backend();
+    char        path[64];
+    char        ver [LEN_VER + 1] = { 0 };
+    int         len_buf;
+    int         size;
+    int         size_max;
+    int         opt;
+    int         fd;
+    int         d;
+    int         m;
+    int         t;
+    int         is_wr;
+
+    while ((opt = getopt(argc, argv, "d:t:s:S:n:b:m:jh")) != -1) {
+        switch (opt) {
+        case 'd': conf.n_minor    = _bench_parse_list(optarg, conf.minor   ); break;
+        case 't': conf.n_n_thread = _bench_parse_list(optarg, conf.n_thread); break;
+        case 's': conf.size_min   = atoi(optarg);                            break;
+        case 'S': conf.size_max   = atoi(optarg);                            break;
+        case 'n': conf.n_op       = atoi(optarg);                            break;
+        case 'b': conf.budget     = atol(optarg);                            break;
+        case 'j': conf.json       = 1;                                       break;
+        case 'm': conf.methods    = _bench_parse_methods(optarg);            break;
+        default:
+            _bench_usage(argv[0]);
+            return  1;
+        }
+    }
+    if ((conf.size_min <= 0) || (conf.n_op <= 0) || (conf.budget <= 0) || (conf.methods == 0)) {
+        _bench_usage(argv[0]);
+        return  1;
+    }
+
+    if (conf.json) {
+        printf("[");
+    } else {
+        printf("method,dir,minor,threads,size,ops,errors,sec,mib_per_sec,ops_per_sec,"
+               "p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    }
+
+    for (d = 0; d < conf.n_minor; d++) {
+        /* buffer size and driver version: recorded to compare driver versions */
+        snprintf(path, sizeof(path), "/dev/%s_%d", NAME_MODULE, conf.minor[d]);
+        fd = be->open(path, O_RDWR);
+        if ((fd < 0) || (be->ioctl(fd, ZNDKCDEV_GET_BUF_LEN, &len_buf) < 0)) {
+            fprintf(stderr, " %s(): error: %s (%d)\n", __func__, path, errno);
+            if (fd >= 0) {
+                be->close(fd);
+            }
+            continue;
+        }
+        be->ioctl(fd, ZNDKCDEV_GET_VERSION, ver);
+        be->close(fd);
+        fprintf(stderr, " %s: %s version %s (%s backend), len_buf=%d\n", path, NAME_MODULE, ver, be->name, len_buf);
+
+        size_max = ((conf.size_max > 0) && (conf.size_max < len_buf)) ? conf.size_max : len_buf;
+        for (m = 0; m < (int)(sizeof(method) / sizeof(method[0])); m++) {
+            if ((conf.methods & method[m]) == 0) {
+                continue;
+            }
+            for (t = 0; t < conf.n_n_thread; t++) {
+                if ((conf.n_thread[t] <= 0) || (conf.n_thread[t] > BENCH_MAX_THREAD)) {
+                    continue;
+                }
+                for (size = conf.size_min; size <= size_max; size = _bench_next_size(size, size_max)) {
+                    for (is_wr = 1; is_wr >= 0; is_wr--) { /* write first: reads see data */
+                        _bench_run(&conf, conf.minor[d], len_buf, method[m], is_wr, conf.n_thread[t], size);
+                    }
+                }
+            }
+        }
+    }
+
+    if (conf.json) {
+        printf("\n]\n");
+    }
+
+    return  0;
+}
+
+/* end */
@@ -14,11 +14,20 @@
  * @author   zundoko
  */
 
+#define  _GNU_SOURCE                    /* splice()    */
+
+#include <fcntl.h>              /* splice()    */
 #include <stdio.h>              /* printf()    */
 #include <stdint.h>             /* uint32_t    */
+#include <string.h>             /* strlen()    */
 #include <unistd.h>             /* getpid()    */
+#include <sys/epoll.h>          /* EPOLLIN     */
+#include <sys/ioctl.h>          /* _IO()       */
+#include <sys/mman.h>           /* mmap()      */
 #include <sys/types.h>          /* pid_t       */
+#include <sys/uio.h>            /* preadv()    */
 
+#include    "zndkcdev.h"        /* zndk driver */
 #include "libzndkcdev.h"        /* zndk lib    */
 
 /**
@@ -39,6 +48,33 @@ _test_zndkcdev_callback(int signum, int dat)
     return  stat;
 }
 
+/**
+ * _test_zndkcdev_uring_callback()
+ * @brief    completion callback of the io_uring requests
+ *
+ * @param    [in] *user        char ::= request name
+ * @param    [in]  res          int ::= result (bytes or -errno)
+ */
+static void
+_test_zndkcdev_uring_callback(void *user, int res)
+{
+    printf("  -> %s(): %s: res=%d\n", __func__, (const char *)user, res);
+}
+
+/**
+ * _test_zndkcdev_cmdq_callback()
+ * @brief    completion callback of the command queue
+ *
+ * @param    [in] *user        char ::= command name
+ * @param    [in]  res          int ::= result (0 or -errno)
+ * @param    [in]  val unsigned long long ::= checksum of buf_checksum
+ */
+static void
+_test_zndkcdev_cmdq_callback(void *user, int res, unsigned long long val)
+{
+    printf("  -> %s(): %s: res=%d, val=0x%llx\n", __func__, (const char *)user, res, val);
+}
+
 /**
  * main()
  * @brief    zndkcdev device driver test application
@@ -69,27 +105,58 @@ main(void)
         }
     }
 
+    /* features */
+    {
+        TZndkCdevFeature  feat;
+
+        stat = zndkcdev_get_feature(fd, &feat);
+        if (stat == 0) {
+            printf("  -> n_dev=%d, len_buf=%d, map_size=%lu, huge=%s\n",
+                   feat.n_dev, feat.len_buf, feat.map_size,
+                   (feat.flags & ZNDKCDEV_FEAT_HUGE_PMD) ? "on" : "off");
+        }
+    }
+
     /* R/W w/ syscals */
     {
         char    rbuf[256] = { 0 };
         char    wbuf[256] = { 0 };
         int     len;
 
-        write(fd, "", 1); 
-        printf("  -> write (clear): %s\n", wbuf);
+        zndkcdev_buf_fill(fd, 0, sizeof(wbuf), 0);
+        printf("  -> fill  (clear): %s\n", wbuf);
 
+        lseek(fd, 0, SEEK_SET);
         read (fd, rbuf, 10);
         printf("  -> read  (check): %s\n", rbuf);
 
         snprintf(wbuf, 20, "%s", "zndkcdev R/W test");
         len = sizeof(wbuf);
+        lseek(fd, 0, SEEK_SET);
         write(fd, wbuf, len); 
         printf("  -> write (again): %s\n", wbuf);
 
+        lseek(fd, 0, SEEK_SET);
         read (fd, rbuf, 20);
         printf("  -> read  (check): %s\n", rbuf);
     }
 
+    /* R/W w/ positional syscalls */
+    {
+        char    rbuf[256] = { 0 };
+        char    wbuf[256] = { 0 };
+        int     len;
+
+        snprintf(wbuf, 20, "%s", "zndkcdev pwrite");
+        len = strlen(wbuf) + 1;
+        pwrite(fd, wbuf, 8, 256);               /* chunk #0 */
+        pwrite(fd, wbuf + 8, len - 8, 256 + 8); /* chunk #1 */
+        printf("  -> pwrite(ofs=256): %s\n", wbuf);
+
+        pread (fd, rbuf, len, 256);
+        printf("  -> pread (check ): %s\n", rbuf);
+    }
+
     /* R/W w/ mmap */
     {
         char *buf;
@@ -98,6 +165,7 @@ main(void)
         char  wbuf[256] = { 0 };
         int   len;
 
+        zndkcdev_set_mmap_mode(fd, ZNDKCDEV_MMAP_WB);
         buf = (char *)zndkcdev_mmap(fd);
 
         printf("  -> write (mmap ): ");
@@ -106,7 +174,9 @@ main(void)
             printf("%c", buf[idx]);
         }
         printf("\n");
+        zndkcdev_buf_sync(fd, 0, 26);
 
+        lseek(fd, 0, SEEK_SET);
         read (fd, rbuf, 26);
         printf("  -> read  (check): %s\n", rbuf);
 
@@ -124,11 +194,293 @@ main(void)
         printf("  -> read  (check): %s\n", rbuf);
     }
 
+    /* R/W w/ vectored syscalls */
+    {
+        char          rbuf[2][16] = { { 0 } };
+        struct iovec  iov [2];
+
+        iov[0].iov_base = "zndkcdev ";  iov[0].iov_len = 9;
+        iov[1].iov_base = "writev";     iov[1].iov_len = 7;
+        pwritev(fd, iov, 2, 512);
+        printf("  -> pwritev(ofs=512): %s%s\n", (char *)iov[0].iov_base, (char *)iov[1].iov_base);
+
+        iov[0].iov_base = rbuf[0];      iov[0].iov_len = 9;
+        iov[1].iov_base = rbuf[1];      iov[1].iov_len = 7;
+        preadv (fd, iov, 2, 512);
+        printf("  -> preadv (check  ): %s%s\n", rbuf[0], rbuf[1]);
+    }
+
+    /* R/W w/ batched ioctl */
+    {
+        char          rbuf[4][8]  = { { 0 } };
+        char          wbuf[4][8]  = { "seg0", "seg1", "seg2", "seg3" };
+        TZndkCdevMem  mem [4];
+        int           rslt[4];
+        int           idx;
+
+        for (idx = 0; idx < 4; idx++) {
+            mem[idx].buf = wbuf[idx];
+            mem[idx].ofs = 1024 * (idx + 1); /* scattered */
+            mem[idx].len = sizeof(wbuf[idx]);
+        }
+        zndkcdev_buf_writev(fd, mem, rslt, 4);
+
+        for (idx = 0; idx < 4; idx++) {
+            mem[idx].buf = rbuf[idx];
+        }
+        zndkcdev_buf_readv (fd, mem, rslt, 4);
+
+        printf("  -> readv (check): ");
+        for (idx = 0; idx < 4; idx++) {
+            printf("%s(%d) ", rbuf[idx], rslt[idx]);
+        }
+        printf("\n");
+    }
+
+    /* R/W w/ FIFO mode */
+    {
+        char    rbuf[256] = { 0 };
+        char    wbuf[256] = { 0 };
+        int     len;
+
+        zndkcdev_set_mode(fd, ZNDKCDEV_MODE_FIFO);
+
+        snprintf(wbuf, 20, "%s", "zndkcdev FIFO test");
+        len = strlen(wbuf) + 1;
+        write(fd, wbuf, 9);                 /* producer: 2 chunks */
+        write(fd, wbuf + 9, len - 9);
+        printf("  -> write (fifo ): %s\n", wbuf);
+
+        {                                   /* wait for data      */
+            int       epfd;
+            int       fds    [1];
+            uint32_t  revents[1];
+            int       n_ready;
+
+            epfd    = zndkcdev_poll_create();
+            zndkcdev_poll_add(epfd, fd, EPOLLIN);
+            n_ready = zndkcdev_poll_wait(epfd, fds, revents, 1, 1000);
+            printf("  -> poll  (fifo ): n_ready=%d, revents=%08X\n", n_ready, (n_ready > 0) ? revents[0] : 0);
+            zndkcdev_poll_del(epfd, fd);
+            close(epfd);
+        }
+
+        read (fd, rbuf, len);               /* consumer           */
+        printf("  -> read  (fifo ): %s\n", rbuf);
+
+        zndkcdev_set_mode(fd, ZNDKCDEV_MODE_FLAT);
+    }
+
+    /* R/W w/ SHARD mode */
+    {
+        char    rbuf[256] = { 0 };
+        char    wbuf[256] = { 0 };
+        int     len;
+
+        zndkcdev_set_mode(fd, ZNDKCDEV_MODE_SHARD);
+
+        snprintf(wbuf, 20, "%s", "zndkcdev SHARD test");
+        len = strlen(wbuf) + 1;
+        write(fd, wbuf, len);               /* producer: shard of this CPU */
+        printf("  -> write (shard): %s\n", wbuf);
+
+        len = zndkcdev_shard_drain(fd, -1, rbuf, sizeof(rbuf));
+        printf("  -> drain (shard): %s (%d)\n", rbuf, len);
+
+        zndkcdev_set_mode(fd, ZNDKCDEV_MODE_FLAT);
+    }
+
     /* send signal from kernel */
     {
         stat = zndkcdev_send_signal(fd, _test_zndkcdev_callback, getpid(), 12345);
     }
 
+    /* create/destroy a device on demand */
+    {
+        int     ctl_fd;
+        int     minor;
+
+        ctl_fd = zndkcdev_ctl_open();
+        if (ctl_fd >= 0) {
+            minor = zndkcdev_dev_create (ctl_fd, -1, 64 * 1024);
+            printf("  -> create  (ctl ): /dev/zndkcdev_%d\n", minor);
+            if (minor >= 0) {
+                stat = zndkcdev_dev_destroy(ctl_fd, minor);
+                printf("  -> destroy (ctl ): /dev/zndkcdev_%d (%d)\n", minor, stat);
+            }
+            zndkcdev_ctl_close(ctl_fd);
+        }
+    }
+
+    /* independent handles: a 2nd device does not disturb the 1st mapping */
+    {
+        TDevHandle *hdl0 = zndkcdev_hdl_get(fd);
+        TDevHandle *hdl1 = zndkcdev_hdl_open("/dev/zndkcdev_1");
+        uint8_t    *map0 = zndkcdev_hdl_mmap(hdl0);
+        uint8_t    *map1 = zndkcdev_hdl_mmap(hdl1);
+
+        if ((map0 != NULL) && (map1 != NULL)) {
+            snprintf((char *)map0, 32, "%s", "handle 0");
+            snprintf((char *)map1, 32, "%s", "handle 1");
+            printf("  -> mmap  (hdl 0): %s, len_buf=%d\n", (char *)map0, hdl0->len_buf);
+            printf("  -> mmap  (hdl 1): %s, len_buf=%d\n", (char *)map1, hdl1->len_buf);
+        }
+        zndkcdev_hdl_close(hdl1);
+    }
+
+    /* asynchronous io_uring requests: write + read back, 2 of them via URING_CMD */
+    {
+        TZndkCdevUring *ur = zndkcdev_uring_create(8);
+        char            wdat[16] = "io_uring";
+        char            rdat[2][16];
+
+        if (ur != NULL) {
+            memset(rdat, 0, sizeof(rdat));
+            zndkcdev_uring_write   (ur, fd, wdat, sizeof(wdat), 512, _test_zndkcdev_uring_callback, "write");
+            zndkcdev_uring_buf_write(ur, fd, 768, sizeof(wdat), wdat, _test_zndkcdev_uring_callback, "buf_write");
+            zndkcdev_uring_wait(ur, 2);
+            zndkcdev_uring_read    (ur, fd, rdat[0], sizeof(rdat[0]), 512, _test_zndkcdev_uring_callback, "read");
+            zndkcdev_uring_buf_read(ur, fd, 768, sizeof(rdat[1]), rdat[1], _test_zndkcdev_uring_callback, "buf_read");
+            zndkcdev_uring_wait(ur, 2);
+            printf("  -> io_uring: %s, %s\n", rdat[0], rdat[1]);
+            zndkcdev_uring_destroy(ur);
+        }
+    }
+
+    /* mmap window: only the 2nd page */
+    {
+        TZndkCdevWindow *win = zndkcdev_hdl_mmap_window(zndkcdev_hdl_get(fd), 4096, 4096);
+        char             rdat[16] = { 0 };
+
+        if (win != NULL) {
+            snprintf((char *)win->map, sizeof(rdat), "%s", "window");
+            zndkcdev_buf_read(fd, win->ofs, sizeof(rdat) - 1, rdat);
+            printf("  -> mmap window %d+%d: %s\n", win->ofs, win->len, rdat);
+            zndkcdev_hdl_munmap_window(win);
+        }
+    }
+
+    /* splice: device -> pipe w/o a user copy (the window block wrote at 4096) */
+    {
+        int      pfd[2];
+        loff_t   off       = 4096;
+        char     rdat[16]  = { 0 };
+        ssize_t  n;
+
+        if (pipe(pfd) == 0) {
+            n = splice(fd, &off, pfd[1], NULL, sizeof(rdat) - 1, 0);
+            if ((n > 0) && (read(pfd[0], rdat, n) == n)) {
+                printf("  -> splice %zd B: %s\n", n, rdat);
+            }
+            close(pfd[0]);
+            close(pfd[1]);
+        }
+    }
+
+    /* dma-buf: export the 1st page, see the same bytes through the dma-buf fd */
+    {
+        int      dmabuf_fd = zndkcdev_export_dmabuf(fd, 0, 4096);
+        char    *map;
+
+        if (dmabuf_fd >= 0) {
+            map = mmap(NULL, 4096, PROT_READ, MAP_SHARED, dmabuf_fd, 0);
+            if (map != MAP_FAILED) {
+                printf("  -> dma-buf fd=%d: %.16s\n", dmabuf_fd, map);
+                munmap(map, 4096);
+            }
+            close(dmabuf_fd);
+        }
+    }
+
+    /* checksum in the kernel: CRC32C("123456789") = 0xe3069283 */
+    {
+        unsigned long long crc;
+        unsigned long long xxh;
+
+        zndkcdev_buf_write(fd, 8192, 9, "123456789");
+        if ((zndkcdev_buf_checksum(fd, 8192, 9, ZNDKCDEV_CSUM_CRC32C, 0, &crc) == 0) &&
+            (zndkcdev_buf_checksum(fd, 8192, 9, ZNDKCDEV_CSUM_XXH64 , 0, &xxh) == 0)) {
+            printf("  -> checksum: crc32c=0x%08llx, xxh64=0x%016llx\n", crc, xxh);
+        }
+    }
+
+    /* fill/move/copy in the kernel */
+    {
+        char    rdat[16] = { 0 };
+
+        zndkcdev_buf_fill(fd, 12288, 8, 'z');
+        zndkcdev_buf_move(fd, 12292, 12288, 8);          /* overlapping */
+        zndkcdev_buf_read(fd, 12288, 12, rdat);
+        printf("  -> fill+move: %s\n", rdat);
+        if (zndkcdev_buf_copy(fd, 12288, 1, 0, 8) == 0) { /* from /dev/zndkcdev_1 */
+            zndkcdev_buf_read(fd, 12288, 8, rdat);
+            printf("  -> copy from minor 1: %.8s\n", rdat);
+        }
+    }
+
+    /* command queue: one doorbell for a batch of commands */
+    {
+        TZndkCdevCmdq *q = zndkcdev_cmdq_create(fd, 8, -1, 0);
+        char           rdat[16] = { 0 };
+
+        if (q != NULL) {
+            zndkcdev_cmdq_buf_write   (q, 16384, 9, "123456789", _test_zndkcdev_cmdq_callback, "buf_write");
+            zndkcdev_cmdq_buf_fill    (q, 16393, 3, '!', _test_zndkcdev_cmdq_callback, "buf_fill");
+            zndkcdev_cmdq_buf_checksum(q, 16384, 9, ZNDKCDEV_CSUM_CRC32C, 0, _test_zndkcdev_cmdq_callback, "buf_checksum");
+            zndkcdev_cmdq_buf_read    (q, 16384, 12, rdat, _test_zndkcdev_cmdq_callback, "buf_read");
+            zndkcdev_cmdq_wait(q, 4);
+            printf("  -> cmdq: %s\n", rdat);
+            zndkcdev_cmdq_destroy(q);
+        }
+    }
+
+    /* FLIP: readers keep the published frame until the next flip */
+    if (zndkcdev_set_mode(fd, ZNDKCDEV_MODE_FLIP) == 0) {
+        unsigned long long gen = 0;
+        const uint8_t     *front;
+        char               rdat[16] = { 0 };
+
+        pwrite(fd, "frame A", 8, 0);            /* -> back frame */
+        zndkcdev_flip(fd, &gen);
+        pwrite(fd, "frame B", 8, 0);            /* not published yet */
+        pread (fd, rdat, 8, 0);
+        printf("  -> flip gen=%llu: %s\n", gen, rdat);
+        zndkcdev_flip(fd, &gen);
+        front = zndkcdev_flip_front(zndkcdev_hdl_get(fd), &gen);
+        if (front != NULL) {
+            memcpy(rdat, front, 8);
+            printf("  -> flip gen=%llu: %s (mmap, %s)\n", gen, rdat,
+                   zndkcdev_flip_valid(zndkcdev_hdl_get(fd), gen) ? "valid" : "retry");
+        }
+        zndkcdev_set_mode(fd, ZNDKCDEV_MODE_FLAT);
+    }
+
+    /* synthetic producer: 64 B records at 64 MB/s into the flat buffer for 10 ms */
+    if (zndkcdev_gen_start(fd, 64, 64ULL * 1000 * 1000, 100, -1) == 0) {
+        TZndkCdevGen gen;
+        TZndkCdevRec rec;
+
+        usleep(10 * 1000);
+        if (zndkcdev_gen_stop(fd, &gen) == 0) {
+            zndkcdev_buf_read(fd, 0, sizeof(TZndkCdevRec), &rec);
+            printf("  -> gen: n_rec=%llu, n_drop=%llu, rec[0]: seq=%llu, magic=0x%08x\n",
+                   gen.n_rec, gen.n_drop, rec.seq, rec.magic);
+        }
+    }
+
+    /* performance counters */
+    {
+        static const char *name[ZNDKCDEV_N_STAT] = { "read", "write", "buf_rd", "buf_wr", "mmap", "signal", "fill", "move", "copy" };
+        TZndkCdevStats     stats;
+        int                op;
+
+        stat = zndkcdev_get_stats(fd, &stats);
+        for (op = 0; (stat == 0) && (op < ZNDKCDEV_N_STAT); op++) {
+            printf("  -> %-6s: ops=%llu, bytes=%llu, errs=%llu\n", name[op],
+                   stats.op[op].n_op, stats.op[op].n_byte, stats.op[op].n_err);
+        }
+    }
+
     /* close */
     sleep(1);                   /* wait for log message out */
     zndkcdev_close(fd);
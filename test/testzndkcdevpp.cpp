@@ -0,0 +1,70 @@
+/**
+ * @file     testzndkcdevpp.cpp
+ * @brief    zndkcdev device driver test application (C++ wrapper: zndkcdev.hpp)
+ *
+ * @note     https://github.com/zundoko/zndkcdev
+ *
+ * @date     2026-10-17
+ * @author   zundoko
+ */
+
+#include <cstdio>               /* printf()    */
+#include <cstdint>              /* uint32_t    */
+#include <exception>            /* exception   */
+#include <utility>              /* std::move() */
+
+#include "zndkcdev.hpp"         /* zndk C++    */
+
+/**
+ * @struct TTestRec
+ * @brief  trivially-copyable record exchanged w/ the driver buffer
+ */
+struct TTestRec {
+    uint32_t id;
+    uint32_t val;
+};
+
+/**
+ * main()
+ * @brief    zndkcdev C++ wrapper test application
+ */
+int
+main(void)
+{
+    try {
+        zndkcdev::Device dev("/dev/zndkcdev_0");
+        zndkcdev::Device own = std::move(dev); /* ownership moves, dev is empty */
+        TTestRec         rec = { 1, 0x5a5a5a5a };
+        TTestRec         chk = {};
+
+        /* typed BUF_WR/BUF_RD */
+        own.write_from(4096, rec);
+        own.read_into (4096, chk);
+        std::printf("  -> read_into : id=%u, val=0x%08x (moved-from: %s)\n",
+                    chk.id, chk.val, dev ? "open" : "empty");
+
+        /* zero-copy view: the same record through the mapping */
+        auto recs = own.view<TTestRec>(4096, 2);
+        recs[1]   = TTestRec{ 2, recs[0].val + 1 };
+        own.read_into(4096 + sizeof(TTestRec), chk);
+        std::printf("  -> view      : id=%u, val=0x%08x, %zu B mapped\n",
+                    chk.id, chk.val, own.bytes().size());
+
+        /* the last record of the buffer is in reach, one byte further is not */
+        own.write_from(own.size() - sizeof(TTestRec), rec);
+        own.read_into (own.size() - sizeof(TTestRec), chk);
+        std::printf("  -> tail      : id=%u, val=0x%08x\n", chk.id, chk.val);
+        try {
+            own.read_into(own.size(), chk);
+        } catch (const std::out_of_range &e) {
+            std::printf("  -> out_of_range: %s\n", e.what());
+        }
+    } catch (const std::exception &e) {
+        std::printf(" %s(): error: %s\n", __func__, e.what());
+        return  1;
+    }
+
+    return  0;
+}
+
+/* end */